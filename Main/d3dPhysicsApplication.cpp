@@ -16,6 +16,9 @@ PhysicsApplication::PhysicsApplication(HINSTANCE hInstance)
     // position and compute the bounding sphere.
     mSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
     mSceneBounds.Radius = sqrtf(2900.0f);
+
+    // the broadphase borrows the workers of the narrowphase, the two never run at the same time
+    mBroadPhase.m_threadPool = &mNarrowPhase.m_threadPool;
 }
 PhysicsApplication::~PhysicsApplication()
 {
@@ -945,35 +948,56 @@ void PhysicsApplication::UpdatePositionAndOrientation(const float deltaSecond) {
         SetCPUStat(PIX_COLOR_DEFAULT, "Physics_Step1_BroadNarrowPhase");
         if (mIsBroadOptimized == true) {
             // BroadPhase
-            std::vector<collisionPair_t> collisionPairs;
+            const std::vector<collisionPair_t>* collisionPairs = nullptr;
             {
                 SetCPUStat(PIX_COLOR_DEFAULT, "Physics_Step1_Sub1_BroadPhase");
-                BroadPhase(mBodies.data(), static_cast<int>(mBodies.size()), collisionPairs, deltaSecond);
+                collisionPairs = &BroadPhase(mBroadPhase, mBroadPhaseType, mBodies.data(), static_cast<int>(mBodies.size()), deltaSecond);
+
+                // manifolds and GJK caches of the pairs that stopped overlapping are dropped right away
+                m_manifolds.RemovePairs(mBodies.data(), mBroadPhase.m_pairCache.GetRemovedPairs());
+                mNarrowPhase.RemovePairs(mBroadPhase.m_pairCache.GetRemovedPairs());
+
+                // the backends started over, the narrowphase does as well rather than trust the pair events
+                if (mBroadPhase.m_isBackendsCleared)
+                    mNarrowPhase.ClearCaches();
             }
 
             // NarrowPhase
-            // TODO: current longest task
             {
                 SetCPUStat(PIX_COLOR_DEFAULT, "Physics_Step1_Sub2_NarrowPhase");
-                // Reserve memory to avoid reallocations
-                contacts.reserve(collisionPairs.size());
-                for (const auto& currentPair : collisionPairs) {
-                    Body* bodyA = &mBodies[currentPair.a];
-                    Body* bodyB = &mBodies[currentPair.b];
-
-                    if (0.0f == bodyA->m_invMass && 0.0f == bodyB->m_invMass)
-                        continue;
-
-                    contact_t contact;
-                    // TODO: current main point to optimize
-                    if (DoesIntersect(bodyA, bodyB, deltaSecond, contact)) {
-                        if (contact.timeOfImpact == 0.0f) {
-                            // static contact
-                            m_manifolds.AddContact(contact);
-                        }
-                        else {
-                            // dynamic contact
-                            contacts.push_back(contact);
+                if (mIsNarrowOptimized == true) {
+                    // pairs are spread over the thread pool, the contacts come back in pair order
+                    mStaticContacts.clear();
+                    NarrowPhase(mNarrowPhase, mBodies.data(), static_cast<int>(mBodies.size()), *collisionPairs, deltaSecond, mStaticContacts, contacts);
+                    for (const contact_t& contact : mStaticContacts)
+                        m_manifolds.AddContact(contact);
+                }
+                else {
+                    // Reserve memory to avoid reallocations
+                    contacts.reserve(collisionPairs->size());
+                    mNarrowPhase.m_numRejectedPairs = 0;
+                    mNarrowPhase.m_numReusedPairs = 0;
+                    mNarrowPhase.UpdateMidPhase(mBodies.data(), static_cast<int>(mBodies.size()));
+                    for (const auto& currentPair : *collisionPairs) {
+                        Body* bodyA = &mBodies[currentPair.a];
+                        Body* bodyB = &mBodies[currentPair.b];
+
+                        if (0.0f == bodyA->m_invMass && 0.0f == bodyB->m_invMass)
+                            continue;
+
+                        // mid-phase, resting contact reuse and the GJK warm start, one pair at a time
+                        contact_t pairContacts[MAX_MANIFOLD_CONTACTS];
+                        const int numContacts = FindContacts_Cached(mNarrowPhase, currentPair, mBodies.data(), deltaSecond, pairContacts);
+                        for (int contactIndex = 0; contactIndex < numContacts; ++contactIndex) {
+                            const contact_t& contact = pairContacts[contactIndex];
+                            if (contact.timeOfImpact == 0.0f) {
+                                // static contact
+                                m_manifolds.AddContact(contact);
+                            }
+                            else {
+                                // dynamic contact
+                                contacts.push_back(contact);
+                            }
                         }
                     }
                 }
@@ -982,6 +1006,9 @@ void PhysicsApplication::UpdatePositionAndOrientation(const float deltaSecond) {
         else {
             // Brute force
             contacts.reserve(mBodies.size()); // Approximation
+            mNarrowPhase.m_numRejectedPairs = 0;
+            mNarrowPhase.m_numReusedPairs = 0;
+            mNarrowPhase.UpdateMidPhase(mBodies.data(), static_cast<int>(mBodies.size()));
 
             for (int currentBodyA = 0; currentBodyA < mBodies.size(); ++currentBodyA) {
                 for (int currentBodyB = currentBodyA + 1; currentBodyB < mBodies.size(); currentBodyB++) {
@@ -991,8 +1018,13 @@ void PhysicsApplication::UpdatePositionAndOrientation(const float deltaSecond) {
                     if (0.0f == bodyA->m_invMass && 0.0f == bodyB->m_invMass)
                         continue;
 
-                    contact_t contact;
-                    if (DoesIntersect(bodyA, bodyB, deltaSecond, contact)) {
+                    collisionPair_t pair;
+                    pair.a = currentBodyA;
+                    pair.b = currentBodyB;
+                    contact_t pairContacts[MAX_MANIFOLD_CONTACTS];
+                    const int numContacts = FindContacts_Cached(mNarrowPhase, pair, mBodies.data(), deltaSecond, pairContacts);
+                    for (int contactIndex = 0; contactIndex < numContacts; ++contactIndex) {
+                        const contact_t& contact = pairContacts[contactIndex];
                         if (contact.timeOfImpact == 0.0f) {
                             // static contact
                             m_manifolds.AddContact(contact);
@@ -1147,8 +1179,18 @@ void PhysicsApplication::ApplyPhysicsOnPickedItem() {
     int numContacts = 0;
     mContactPoints.clear();
     mRenderItemsContactPoints.clear();
-    for (int i = 0; i < mBodies.size(); i++) {
-        for (int j = i + 1; j < mBodies.size(); j++) {
+
+    // Swept bounds of every body, each body is tested against all the later ones in SIMD batches
+    // so only the pairs with overlapping bounds go through DoesIntersect
+    const int numBodies = static_cast<int>(mBodies.size());
+    SweptBoundsBuffer sweptBounds;
+    sweptBounds.Update(mBodies.data(), numBodies, GeneralData::FixedDeltaTime);
+    std::vector<int> overlappingBodies(numBodies);
+
+    for (int i = 0; i < numBodies; i++) {
+        const int numOverlaps = IntersectBoundsBatch(sweptBounds.GetBounds(i), sweptBounds.GetSoA(i + 1), numBodies - (i + 1), overlappingBodies.data());
+        for (int overlapIndex = 0; overlapIndex < numOverlaps; overlapIndex++) {
+            const int j = i + 1 + overlappingBodies[overlapIndex];
             Body* bodyA = &mBodies[i];
             Body* bodyB = &mBodies[j];
 
@@ -1317,6 +1359,8 @@ void PhysicsApplication::CleanupSceneResources() {
 
     // reset other data
     m_manifolds.Clear();
+    mBroadPhase.Clear();
+    mNarrowPhase.Clear();
 
     mCurrentAvailableFrameHistoryIndex = 0;
     mFrameHistory.clear();
@@ -2494,11 +2538,36 @@ void PhysicsApplication::RenderDemoUIStressTest() {
         mIsBroadOptimized = !mIsBroadOptimized;
         mIsRestartNeeded = true;
     }
+    if (mIsBroadOptimized) {
+        nameIsOnOff = (mBroadPhaseType == BroadPhaseType::SWEEP_AND_PRUNE ? "On" : "Off");
+        if (ImGui::Button(("SAP: " + nameIsOnOff).c_str())) {
+            mBroadPhaseType = BroadPhaseType::SWEEP_AND_PRUNE;
+            mIsRestartNeeded = true;
+        }
+        nameIsOnOff = (mBroadPhaseType == BroadPhaseType::DYNAMIC_TREE ? "On" : "Off");
+        if (ImGui::Button(("Tree: " + nameIsOnOff).c_str())) {
+            mBroadPhaseType = BroadPhaseType::DYNAMIC_TREE;
+            mIsRestartNeeded = true;
+        }
+        nameIsOnOff = (mBroadPhaseType == BroadPhaseType::SPATIAL_HASH_GRID ? "On" : "Off");
+        if (ImGui::Button(("Grid: " + nameIsOnOff).c_str())) {
+            mBroadPhaseType = BroadPhaseType::SPATIAL_HASH_GRID;
+            mIsRestartNeeded = true;
+        }
+        nameIsOnOff = (mBroadPhaseType == BroadPhaseType::HIERARCHICAL_GRID ? "On" : "Off");
+        if (ImGui::Button(("HGrid: " + nameIsOnOff).c_str())) {
+            mBroadPhaseType = BroadPhaseType::HIERARCHICAL_GRID;
+            mIsRestartNeeded = true;
+        }
+        ImGui::Text("Pruned pairs: %d", mBroadPhase.m_numRejectedPairs);
+    }
     nameIsOnOff = (mIsNarrowOptimized ? "On" : "Off");
     if (ImGui::Button(("NarrowPhase: " + nameIsOnOff).c_str())) {
         mIsNarrowOptimized = !mIsNarrowOptimized;
         mIsRestartNeeded = true;
     }
+    ImGui::Text("Mid-phase rejected pairs: %d", mNarrowPhase.m_numRejectedPairs);
+    ImGui::Text("Resting pairs reused: %d", mNarrowPhase.m_numReusedPairs);
     ImGui::End();
 
 
@@ -18,6 +18,7 @@
 #include "../Physics/GJK.h"
 #include "../Physics/Intersections.h"
 #include "../Physics/Manifold.h"
+#include "../Physics/Narrowphase.h"
 
 // scene management
 #include "../Renderer/StateData.h"
@@ -341,6 +342,9 @@ private:
     std::vector<Body> mBodies;
     std::vector<Constraint*> mConstraints;
     ManifoldCollector m_manifolds;
+    BroadPhaseContext mBroadPhase;
+    NarrowPhaseContext mNarrowPhase;
+    std::vector<contact_t> mStaticContacts; // contacts against static bodies, refilled every step
     std::vector<std::pair<unsigned int, unsigned int>> geometryStartEndIndices;
 
     // scene state
@@ -388,6 +392,7 @@ public:
     // scene related values
     SandboxState mSandboxState = SandboxState::STACK;
     bool mIsBroadOptimized = true;
+    BroadPhaseType mBroadPhaseType = BroadPhaseType::SWEEP_AND_PRUNE;
     bool mIsNarrowOptimized = true;
     bool mIsStressTestShapeSphere = true;
     bool mIsStressTestSceneDense = true;
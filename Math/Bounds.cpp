@@ -4,6 +4,7 @@
 #include "PCH.h"
 #include "Bounds.h"
 #include "../Physics/Body.h"
+#include "SIMD.h"
 
 /*
 ====================================================
@@ -31,6 +32,21 @@ bool Bounds::DoesIntersect( const Bounds & rhs ) const {
 	return true;
 }
 
+/*
+====================================================
+Bounds::Contains
+====================================================
+*/
+bool Bounds::Contains( const Bounds & rhs ) const {
+	if ( rhs.mins.x < mins.x || rhs.mins.y < mins.y || rhs.mins.z < mins.z ) {
+		return false;
+	}
+	if ( rhs.maxs.x > maxs.x || rhs.maxs.y > maxs.y || rhs.maxs.z > maxs.z ) {
+		return false;
+	}
+	return true;
+}
+
 /*
 ====================================================
 Bounds::Expand
@@ -77,4 +93,99 @@ Bounds::Expand
 void Bounds::Expand( const Bounds & rhs ) {
 	Expand( rhs.mins );
 	Expand( rhs.maxs );
-}
\ No newline at end of file
+}
+
+#if defined( SIMD_AVX2_DISPATCH )
+/*
+====================================================
+IntersectBoundsBatch_AVX2
+
+The 8-wide part of IntersectBoundsBatch, built for AVX2 on its own.
+Tests the boxes eight at a time and returns the index of the first box left over.
+====================================================
+*/
+static AVX2_TARGET int IntersectBoundsBatch_AVX2( const Bounds & bounds, const boundsSoA_t & boxes, const int count, int * hitIndices, int & numHits ) {
+	const __m256 queryMinX = _mm256_set1_ps( bounds.mins.x );
+	const __m256 queryMinY = _mm256_set1_ps( bounds.mins.y );
+	const __m256 queryMinZ = _mm256_set1_ps( bounds.mins.z );
+	const __m256 queryMaxX = _mm256_set1_ps( bounds.maxs.x );
+	const __m256 queryMaxY = _mm256_set1_ps( bounds.maxs.y );
+	const __m256 queryMaxZ = _mm256_set1_ps( bounds.maxs.z );
+
+	int boxIndex = 0;
+	for ( ; boxIndex + 8 <= count; boxIndex += 8 ) {
+		__m256 separated = _mm256_cmp_ps( _mm256_loadu_ps( boxes.maxs[ 0 ] + boxIndex ), queryMinX, _CMP_LT_OQ );
+		separated = _mm256_or_ps( separated, _mm256_cmp_ps( _mm256_loadu_ps( boxes.maxs[ 1 ] + boxIndex ), queryMinY, _CMP_LT_OQ ) );
+		separated = _mm256_or_ps( separated, _mm256_cmp_ps( _mm256_loadu_ps( boxes.maxs[ 2 ] + boxIndex ), queryMinZ, _CMP_LT_OQ ) );
+		separated = _mm256_or_ps( separated, _mm256_cmp_ps( queryMaxX, _mm256_loadu_ps( boxes.mins[ 0 ] + boxIndex ), _CMP_LT_OQ ) );
+		separated = _mm256_or_ps( separated, _mm256_cmp_ps( queryMaxY, _mm256_loadu_ps( boxes.mins[ 1 ] + boxIndex ), _CMP_LT_OQ ) );
+		separated = _mm256_or_ps( separated, _mm256_cmp_ps( queryMaxZ, _mm256_loadu_ps( boxes.mins[ 2 ] + boxIndex ), _CMP_LT_OQ ) );
+
+		const int hitMask = ~_mm256_movemask_ps( separated ) & 0xFF;
+		for ( int lane = 0; lane < 8; ++lane ) {
+			if ( hitMask & ( 1 << lane ) ) {
+				hitIndices[ numHits++ ] = boxIndex + lane;
+			}
+		}
+	}
+	return boxIndex;
+}
+#endif
+
+/*
+====================================================
+IntersectBoundsBatch
+
+Tests the bounds against boxes [0, count) and writes the indices of the overlapping ones
+to hitIndices (room for count entries), returns the number of hits.
+Eight boxes per step when the CPU has AVX2, four with SSE, the remainder and other targets are scalar.
+====================================================
+*/
+int IntersectBoundsBatch( const Bounds & bounds, const boundsSoA_t & boxes, const int count, int * hitIndices ) {
+	int numHits = 0;
+	int boxIndex = 0;
+
+#if defined( SIMD_AVX2_DISPATCH )
+	if ( HasAVX2() ) {
+		boxIndex = IntersectBoundsBatch_AVX2( bounds, boxes, count, hitIndices, numHits );
+	}
+#endif
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+	{
+		const __m128 queryMinX = _mm_set1_ps( bounds.mins.x );
+		const __m128 queryMinY = _mm_set1_ps( bounds.mins.y );
+		const __m128 queryMinZ = _mm_set1_ps( bounds.mins.z );
+		const __m128 queryMaxX = _mm_set1_ps( bounds.maxs.x );
+		const __m128 queryMaxY = _mm_set1_ps( bounds.maxs.y );
+		const __m128 queryMaxZ = _mm_set1_ps( bounds.maxs.z );
+
+		for ( ; boxIndex + 4 <= count; boxIndex += 4 ) {
+			__m128 separated = _mm_cmplt_ps( _mm_loadu_ps( boxes.maxs[ 0 ] + boxIndex ), queryMinX );
+			separated = _mm_or_ps( separated, _mm_cmplt_ps( _mm_loadu_ps( boxes.maxs[ 1 ] + boxIndex ), queryMinY ) );
+			separated = _mm_or_ps( separated, _mm_cmplt_ps( _mm_loadu_ps( boxes.maxs[ 2 ] + boxIndex ), queryMinZ ) );
+			separated = _mm_or_ps( separated, _mm_cmplt_ps( queryMaxX, _mm_loadu_ps( boxes.mins[ 0 ] + boxIndex ) ) );
+			separated = _mm_or_ps( separated, _mm_cmplt_ps( queryMaxY, _mm_loadu_ps( boxes.mins[ 1 ] + boxIndex ) ) );
+			separated = _mm_or_ps( separated, _mm_cmplt_ps( queryMaxZ, _mm_loadu_ps( boxes.mins[ 2 ] + boxIndex ) ) );
+
+			const int hitMask = ~_mm_movemask_ps( separated ) & 0xF;
+			for ( int lane = 0; lane < 4; ++lane ) {
+				if ( hitMask & ( 1 << lane ) ) {
+					hitIndices[ numHits++ ] = boxIndex + lane;
+				}
+			}
+		}
+	}
+#endif
+
+	for ( ; boxIndex < count; ++boxIndex ) {
+		if ( boxes.maxs[ 0 ][ boxIndex ] < bounds.mins.x || boxes.maxs[ 1 ][ boxIndex ] < bounds.mins.y || boxes.maxs[ 2 ][ boxIndex ] < bounds.mins.z ) {
+			continue;
+		}
+		if ( bounds.maxs.x < boxes.mins[ 0 ][ boxIndex ] || bounds.maxs.y < boxes.mins[ 1 ][ boxIndex ] || bounds.maxs.z < boxes.mins[ 2 ][ boxIndex ] ) {
+			continue;
+		}
+		hitIndices[ numHits++ ] = boxIndex;
+	}
+	return numHits;
+}
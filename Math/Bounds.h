@@ -18,6 +18,7 @@ public:
 
 	void Clear() { mins = Vec3( 1e6 ); maxs = Vec3( -1e6 ); }
 	bool DoesIntersect( const Bounds & rhs ) const;
+	bool Contains( const Bounds & rhs ) const;
 	void Expand( const Vec3 * pts, const int num );
 	void Expand( const Vec3 & rhs );
 	void Expand( const Bounds & rhs );
@@ -25,8 +26,23 @@ public:
 	float WidthX() const { return maxs.x - mins.x; }
 	float WidthY() const { return maxs.y - mins.y; }
 	float WidthZ() const { return maxs.z - mins.z; }
+	float GetSurfaceArea() const { return 2.0f * ( WidthX() * WidthY() + WidthY() * WidthZ() + WidthZ() * WidthX() ); }
 
 public:
 	Vec3 mins;
 	Vec3 maxs;
-};
\ No newline at end of file
+};
+
+/*
+====================================================
+boundsSoA_t
+
+Boxes stored as one array per axis for the mins and the maxs
+====================================================
+*/
+struct boundsSoA_t {
+	const float * mins[ 3 ];
+	const float * maxs[ 3 ];
+};
+
+int IntersectBoundsBatch( const Bounds & bounds, const boundsSoA_t & boxes, const int count, int * hitIndices );
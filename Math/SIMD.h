@@ -0,0 +1,57 @@
+//
+//	SIMD.h
+//
+#pragma once
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+
+/*
+====================================================
+AVX2 dispatch
+
+SSE2 is the baseline of every x86 build. The 8-wide kernels are compiled for AVX2 one function at a time
+(AVX2_TARGET) and are only called when HasAVX2() says the CPU and the OS support them,
+so the program still starts on machines without AVX2.
+====================================================
+*/
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __x86_64__ ) || defined( __i386__ )
+#define SIMD_AVX2_DISPATCH
+
+#if defined( _MSC_VER )
+#define AVX2_TARGET		// MSVC emits AVX2 intrinsics without /arch:AVX2
+#else
+#define AVX2_TARGET __attribute__( ( target( "avx2" ) ) )
+#endif
+
+inline bool DetectAVX2() {
+#if defined( _MSC_VER )
+	int info[ 4 ];
+	__cpuid( info, 0 );
+	if ( info[ 0 ] < 7 ) {
+		return false;
+	}
+
+	// the OS has to save the YMM registers, OSXSAVE and AVX in leaf 1, XMM and YMM state in XCR0
+	__cpuid( info, 1 );
+	const int osxsaveAndAVX = ( 1 << 27 ) | ( 1 << 28 );
+	if ( ( info[ 2 ] & osxsaveAndAVX ) != osxsaveAndAVX || ( _xgetbv( 0 ) & 6 ) != 6 ) {
+		return false;
+	}
+
+	__cpuidex( info, 7, 0 );
+	return 0 != ( info[ 1 ] & ( 1 << 5 ) );
+#else
+	__builtin_cpu_init();
+	return 0 != __builtin_cpu_supports( "avx2" );
+#endif
+}
+
+// Checked once, the answer doesn't change while the program runs
+inline bool HasAVX2() {
+	static const bool hasAVX2 = DetectAVX2();
+	return hasAVX2;
+}
+#endif
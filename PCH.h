@@ -57,7 +57,13 @@
 #include <sstream>
 #include <iomanip>
 #include <map>
+#include <set>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 #include <cassert>
 #include <cstdint>
@@ -83,29 +83,60 @@ void Body::ApplyImpulseAngular(const Vec3& angularImpulse) {
 }
 
 
+bodyTransform_t Body::GetTransform() const {
+	bodyTransform_t transform;
+	transform.shape = m_shape;
+	transform.position = m_position;
+	transform.orientation = m_orientation;
+	transform.linearVelocity = m_linearVelocity;
+	transform.angularVelocity = m_angularVelocity;
+	return transform;
+}
 void Body::Update(const float deltaSecond) {
-    m_position += m_linearVelocity * deltaSecond;
+    bodyTransform_t transform = GetTransform();
+    transform.Update(deltaSecond);
+
+    m_position = transform.position;
+    m_orientation = transform.orientation;
+    m_angularVelocity = transform.angularVelocity;
+}
+
+
+/*
+====================================================
+bodyTransform_t
+====================================================
+*/
+Vec3 bodyTransform_t::GetCenterOfMassWorldSpace() const {
+	return position + orientation.RotatePoint(shape->GetCenterOfMass());
+}
+Vec3 bodyTransform_t::WorldSpaceToBodySpace(const Vec3& worldPt) const {
+	Vec3 tmp = worldPt - GetCenterOfMassWorldSpace();
+	return orientation.Inverse().RotatePoint(tmp);
+}
+void bodyTransform_t::Update(const float deltaSecond) {
+    position += linearVelocity * deltaSecond;
 
     Vec3 centerOfMass = GetCenterOfMassWorldSpace();
-    Vec3 comToPos = m_position - centerOfMass;
+    Vec3 comToPos = position - centerOfMass;
 
-    Mat3 orientation = m_orientation.ToMat3();
+    Mat3 orientationMatrix = orientation.ToMat3();
     // Transform the inertia tensor from body space to world space
-    Mat3 inertiaTensor = orientation * m_shape->GetInertiaTensor() * orientation.Transpose();
+    Mat3 inertiaTensor = orientationMatrix * shape->GetInertiaTensor() * orientationMatrix.Transpose();
     // Compute the angular acceleration
-    Vec3 acceleration = inertiaTensor.Inverse() * (m_angularVelocity.Cross(inertiaTensor * m_angularVelocity));
-    m_angularVelocity += acceleration * deltaSecond; // angular acceleration times delta time = delta angular velocity
+    Vec3 acceleration = inertiaTensor.Inverse() * (angularVelocity.Cross(inertiaTensor * angularVelocity));
+    angularVelocity += acceleration * deltaSecond; // angular acceleration times delta time = delta angular velocity
 
 
     // Update orientation
     // This vector's direction is the axis of rotation, and its magnitude is the angle (in radians)
-    Vec3 deltaAngle = m_angularVelocity * deltaSecond;
+    Vec3 deltaAngle = angularVelocity * deltaSecond;
     Quat deltaQuat = Quat(deltaAngle, deltaAngle.GetMagnitude());
-    m_orientation = deltaQuat * m_orientation;
+    orientation = deltaQuat * orientation;
     // Normalize the quaternion to prevent numerical drift (quaternions must have magnitude 1)
-    m_orientation.Normalize();
+    orientation.Normalize();
 
     // Update the reference position by rotating the offset vector around the center of mass
-    // This ensures the position follows the body's rotation although m_position isn’t the center of mass
-    m_position = centerOfMass + deltaQuat.RotatePoint(comToPos);
+    // This ensures the position follows the body's rotation although position isn’t the center of mass
+    position = centerOfMass + deltaQuat.RotatePoint(comToPos);
 }
@@ -3,6 +3,27 @@
 //
 #pragma once
 
+/*
+====================================================
+bodyTransform_t
+
+The pose and velocities of a body, copied out so that the time of impact
+queries can advance it without stepping the body back and forth.
+====================================================
+*/
+struct bodyTransform_t {
+	const Shape *	shape;
+	Vec3			position;
+	Quat			orientation;
+	Vec3			linearVelocity;
+	Vec3			angularVelocity;
+
+	Vec3 GetCenterOfMassWorldSpace() const;
+	Vec3 WorldSpaceToBodySpace( const Vec3 & pt ) const;
+
+	void Update( const float deltaSecond );
+};
+
 /*
 ====================================================
 Body
@@ -34,6 +55,8 @@ public:
 	Vec3 WorldSpaceToBodySpace(const Vec3& pt) const;
 	Vec3 BodySpaceToWorldSpace(const Vec3& pt) const;
 
+	bodyTransform_t GetTransform() const;
+
 	Mat3 GetInverseInertiaTensorBodySpace() const;
 	Mat3 GetInverseInertiaTensorWorldSpace() const;
 
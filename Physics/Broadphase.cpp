@@ -5,103 +5,149 @@
 #include "Broadphase.h"
 
 
-int CompareSAP(const void* lhs, const void* rhs) {
-	const pseudoBody_t* left = reinterpret_cast<const pseudoBody_t*>(lhs);
-	const pseudoBody_t* right = reinterpret_cast<const pseudoBody_t*>(rhs);
+/*
+====================================================
+GetSortableKey
 
-	if (left->value < right->value)
-		return -1;
-	return 1;
+Flips the float bits so that unsigned integer order matches float order.
+====================================================
+*/
+static uint32_t GetSortableKey(const float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t mask = (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+    return bits ^ mask;
 }
-void SortBodiesBounds(const Body* bodies, const int numBodies, pseudoBody_t* sortedArray, const float deltaSecond) {
 
-    // --- 1. Dynamic Axis Selection for Optimal Sweep-and-Prune ---
-    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
-    float maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = -FLT_MAX;
+static const int RADIX_BITS = 11;
+static const int RADIX_BUCKETS = 1 << RADIX_BITS;
+static const int RADIX_PASSES = 3;
+static const int RADIX_PARALLEL_THRESHOLD = 1 << 16;	// endpoints needed before the sort is split across threads
+static const int RADIX_MAX_CHUNKS = 8;
 
-    // First pass to determine the global bounds and select the axis with the largest extent.
-    for (int i = 0; i < numBodies; ++i) {
-        const Body& body = bodies[i];
-        Bounds bounds = body.m_shape->GetBounds(body.m_position, body.m_orientation);
+/*
+====================================================
+GetRadixDigit
 
-        // Expand bounds for continuous collision detection (CCD)
-        bounds.Expand(bounds.mins + body.m_linearVelocity * deltaSecond);
-        bounds.Expand(bounds.maxs + body.m_linearVelocity * deltaSecond);
+The sort key is 33 bits, the isMin flag sits below the float key so that
+min endpoints come first on ties, the same order as IsEndpointLess.
+====================================================
+*/
+static uint32_t GetRadixDigit(const pseudoBody_t& endpoint, const int pass) {
+    const uint32_t key = GetSortableKey(endpoint.value);
+    if (0 == pass)
+        return ((key & 0x3FFu) << 1) | (endpoint.isMin ? 0u : 1u);
+    if (1 == pass)
+        return (key >> 10) & 0x7FFu;
+    return key >> 21;
+}
 
-        // Optional epsilon expansion to prevent issues at boundaries
-        const float epsilon = 0.01f;
-        bounds.Expand(bounds.mins + Vec3(-1, -1, -1) * epsilon);
-        bounds.Expand(bounds.maxs + Vec3(1, 1, 1) * epsilon);
+/*
+====================================================
+RadixSortEndpoints
 
-        // Update global bounds
-        minX = std::min(minX, bounds.mins.x); maxX = std::max(maxX, bounds.maxs.x);
-        minY = std::min(minY, bounds.mins.y); maxY = std::max(maxY, bounds.maxs.y);
-        minZ = std::min(minZ, bounds.mins.z); maxZ = std::max(maxZ, bounds.maxs.z);
-    }
+LSD radix sort, 3 passes of 11 bits. Large inputs are split into chunks that run on the thread pool,
+each chunk builds a histogram of its endpoints and then scatters them to offsets that keep the sort stable.
+Without a thread pool, or for small inputs, everything runs on the calling thread.
+The sweep keeps it off the per-step path, it only orders the endpoints of a rebuild.
+====================================================
+*/
+void RadixSortEndpoints(pseudoBody_t* endpoints, const int numEndpoints, sweepScratch_t& scratch, ThreadPool* threadPool) {
+    if (numEndpoints <= 1)
+        return;
 
-    // Select the axis with the largest extent (best for minimizing overlaps)
-    float extentX = maxX - minX;
-    float extentY = maxY - minY;
-    float extentZ = maxZ - minZ;
+    int numChunks = 1;
+    if (nullptr != threadPool && numEndpoints >= RADIX_PARALLEL_THRESHOLD)
+        numChunks = std::min(threadPool->GetNumThreads(), RADIX_MAX_CHUNKS);
+    const int chunkSize = (numEndpoints + numChunks - 1) / numChunks;
 
-    Vec3 axis;
-    if (extentX >= extentY && extentX >= extentZ) {
-        axis = Vec3(1, 0, 0); // X axis chosen
-    }
-    else if (extentY >= extentX && extentY >= extentZ) {
-        axis = Vec3(0, 1, 0); // Y axis chosen
-    }
-    else {
-        axis = Vec3(0, 0, 1); // Z axis chosen
-    }
+    if (static_cast<int>(scratch.sortedEndpoints.size()) < numEndpoints)
+        scratch.sortedEndpoints.resize(numEndpoints);
+    std::vector<int>& histograms = scratch.histograms;
+    histograms.resize(numChunks * RADIX_BUCKETS);
+    pseudoBody_t* source = endpoints;
+    pseudoBody_t* destination = scratch.sortedEndpoints.data();
 
-    // --- 2. Project Bounds onto the Chosen Axis ---
-    // Note: If Vec3(1, 1, 1) was intentional for a custom non-axis aligned sweep, 
-    // the axis selection logic should be removed, but this is less common for SAP.
+    // Runs task(chunkIndex) for every chunk, on the thread pool when there is more than one
+    auto runChunks = [&](const std::function<void(int)>& task) {
+        if (1 == numChunks) {
+            task(0);
+            return;
+        }
+        threadPool->ParallelFor(numChunks, 1, [&](const int begin, const int end, const int threadIndex) {
+            for (int chunkIndex = begin; chunkIndex < end; ++chunkIndex)
+                task(chunkIndex);
+        });
+    };
 
-    for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
-        const Body& body = bodies[currentBodyIndex];
-        // Must recalculate bounds if they were optimized away in the first loop
-        Bounds bounds = body.m_shape->GetBounds(body.m_position, body.m_orientation);
+    for (int pass = 0; pass < RADIX_PASSES; ++pass) {
+        std::fill(histograms.begin(), histograms.end(), 0);
 
-        // Expand bounds for continuous collision detection (CCD)
-        bounds.Expand(bounds.mins + body.m_linearVelocity * deltaSecond);
-        bounds.Expand(bounds.maxs + body.m_linearVelocity * deltaSecond);
+        runChunks([&](const int chunkIndex) {
+            const int chunkBegin = chunkIndex * chunkSize;
+            const int chunkEnd = std::min(numEndpoints, chunkBegin + chunkSize);
+            int* histogram = &histograms[chunkIndex * RADIX_BUCKETS];
+            for (int endpointIndex = chunkBegin; endpointIndex < chunkEnd; ++endpointIndex)
+                ++histogram[GetRadixDigit(source[endpointIndex], pass)];
+        });
 
-        const float epsilon = 0.01f;
-        bounds.Expand(bounds.mins + Vec3(-1, -1, -1) * epsilon);
-        bounds.Expand(bounds.maxs + Vec3(1, 1, 1) * epsilon);
+        // Turn the counts into write offsets, ordered by digit first and then by chunk to stay stable
+        int offset = 0;
+        bool isPassNeeded = true;
+        for (int digit = 0; digit < RADIX_BUCKETS; ++digit) {
+            const int digitBegin = offset;
+            for (int chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex) {
+                int& count = histograms[chunkIndex * RADIX_BUCKETS + digit];
+                const int start = offset;
+                offset += count;
+                count = start;
+            }
+            if (offset - digitBegin == numEndpoints)
+                isPassNeeded = false;	// every key has the same digit
+        }
+        if (!isPassNeeded)
+            continue;
 
-        // Project min endpoint
-        sortedArray[currentBodyIndex * 2 + 0].id = currentBodyIndex;
-        sortedArray[currentBodyIndex * 2 + 0].value = axis.Dot(bounds.mins);
-        sortedArray[currentBodyIndex * 2 + 0].isMin = true;
+        runChunks([&](const int chunkIndex) {
+            const int chunkBegin = chunkIndex * chunkSize;
+            const int chunkEnd = std::min(numEndpoints, chunkBegin + chunkSize);
+            int* offsets = &histograms[chunkIndex * RADIX_BUCKETS];
+            for (int endpointIndex = chunkBegin; endpointIndex < chunkEnd; ++endpointIndex)
+                destination[offsets[GetRadixDigit(source[endpointIndex], pass)]++] = source[endpointIndex];
+        });
 
-        // Project max endpoint
-        sortedArray[currentBodyIndex * 2 + 1].id = currentBodyIndex;
-        sortedArray[currentBodyIndex * 2 + 1].value = axis.Dot(bounds.maxs);
-        sortedArray[currentBodyIndex * 2 + 1].isMin = false;
+        std::swap(source, destination);
     }
 
-    // 3. Sort the endpoints array. Assuming CompareSAP handles float comparison correctly.
-    qsort(sortedArray, numBodies * 2, sizeof(pseudoBody_t), CompareSAP);
+    if (source != endpoints)
+        std::copy(source, source + numEndpoints, endpoints);
 }
-void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const pseudoBody_t* sortedBodies, const int numBodies) {
-    collisionPairs.clear();
 
-    // The Active List stores the ID of bodies currently overlapping along the sweep axis.
-    std::vector<int> activeList;
+static const int SLAB_ENDPOINTS = 4096;	// endpoints per slab, fixed so the output doesn't depend on the core count
+static const int MAX_SLABS = 64;
+
+/*
+====================================================
+SweepSlab
 
-    const int doubleNumBodies = numBodies * 2;
-    for (int targetBodyIndex = 0; targetBodyIndex < doubleNumBodies; ++targetBodyIndex) {
+Sweeps the endpoints [slabBegin, slabEnd) starting from the bodies that were already open at slabBegin.
+A pair is emitted at the min endpoint of the body that enters last, so every pair belongs to exactly one slab.
+====================================================
+*/
+static void SweepSlab(const pseudoBody_t* sortedBodies, const int slabBegin, const int slabEnd, const std::vector<int>& openBodies,
+    activeList_t& activeList, std::vector<collisionPair_t>& collisionPairs) {
+    for (const int bodyId : openBodies)
+        activeList.Add(bodyId);
+
+    for (int targetBodyIndex = slabBegin; targetBodyIndex < slabEnd; ++targetBodyIndex) {
         const pseudoBody_t& targetBody = sortedBodies[targetBodyIndex];
-        int bodyId = targetBody.id;
+        const int bodyId = targetBody.id;
 
         if (targetBody.isMin) {
             // Min Endpoint: The body enters the sweep axis.
 
             // Generate pairs with all bodies currently in the Active List (i.e., overlapping bodies).
-            for (int activeId : activeList) {
+            for (const int activeId : activeList.ids) {
                 collisionPair_t pair;
                 // Ensure pair.a < pair.b for canonical pairing (optional but good practice)
                 pair.a = std::min(bodyId, activeId);
@@ -110,28 +156,1006 @@ void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const pseudoBody_t
             }
 
             // Add the entering body to the Active List.
-            activeList.push_back(bodyId);
-
+            activeList.Add(bodyId);
         }
         else {
             // Max Endpoint: The body exits the sweep axis.
+            activeList.Remove(bodyId);
+        }
+    }
+
+    activeList.Reset();
+}
+
+/*
+====================================================
+BuildPairs
+
+The sorted endpoints are split into slabs that are swept on the thread pool into their own pair buffers.
+The buffers are appended in slab order, so the result is the same on any number of threads.
+====================================================
+*/
+void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const pseudoBody_t* sortedBodies, const int numBodies, sweepScratch_t& scratch, ThreadPool* threadPool) {
+    collisionPairs.clear();
+
+    const int numEndpoints = numBodies * 2;
+    const int numSlabs = std::max(1, std::min(numEndpoints / SLAB_ENDPOINTS, MAX_SLABS));
+    const int slabSize = (numEndpoints + numSlabs - 1) / numSlabs;
+    const int numThreads = (nullptr != threadPool && numSlabs > 1) ? threadPool->GetNumThreads() : 1;
+
+    // the slots stay -1 between sweeps, they only need to grow with the bodies
+    if (static_cast<int>(scratch.activeLists.size()) < numThreads)
+        scratch.activeLists.resize(numThreads);
+    for (int threadIndex = 0; threadIndex < numThreads; ++threadIndex) {
+        std::vector<int>& slots = scratch.activeLists[threadIndex].slots;
+        if (static_cast<int>(slots.size()) < numBodies)
+            slots.resize(numBodies, -1);
+    }
+
+    if (1 == numSlabs) {
+        static const std::vector<int> noOpenBodies;
+        SweepSlab(sortedBodies, 0, numEndpoints, noOpenBodies, scratch.activeLists[0], collisionPairs);
+        return;
+    }
+
+    // Bodies whose interval spans a slab boundary are already open when that slab starts
+    scratch.minIndices.resize(numBodies);
+    for (int endpointIndex = 0; endpointIndex < numEndpoints; ++endpointIndex) {
+        if (sortedBodies[endpointIndex].isMin)
+            scratch.minIndices[sortedBodies[endpointIndex].id] = endpointIndex;
+    }
+    if (static_cast<int>(scratch.openBodies.size()) < numSlabs) {
+        scratch.openBodies.resize(numSlabs);
+        scratch.slabPairs.resize(numSlabs);
+    }
+    for (int slab = 0; slab < numSlabs; ++slab) {
+        scratch.openBodies[slab].clear();
+        scratch.slabPairs[slab].clear();
+    }
+    for (int endpointIndex = 0; endpointIndex < numEndpoints; ++endpointIndex) {
+        if (sortedBodies[endpointIndex].isMin)
+            continue;
+        const int bodyId = sortedBodies[endpointIndex].id;
+        const int firstSlab = scratch.minIndices[bodyId] / slabSize + 1;
+        const int lastSlab = endpointIndex / slabSize;
+        for (int slab = firstSlab; slab <= lastSlab; ++slab)
+            scratch.openBodies[slab].push_back(bodyId);
+    }
+
+    // Sweep the slabs on the worker threads, each thread owns its active list
+    auto sweepSlabs = [&](const int begin, const int end, const int threadIndex) {
+        for (int slab = begin; slab < end; ++slab) {
+            const int slabBegin = slab * slabSize;
+            const int slabEnd = std::min(numEndpoints, slabBegin + slabSize);
+            SweepSlab(sortedBodies, slabBegin, slabEnd, scratch.openBodies[slab], scratch.activeLists[threadIndex], scratch.slabPairs[slab]);
+        }
+    };
+    if (nullptr != threadPool)
+        threadPool->ParallelFor(numSlabs, 1, sweepSlabs);
+    else
+        sweepSlabs(0, numSlabs, 0);
+
+    // Deterministic merge
+    size_t numPairs = 0;
+    for (int slab = 0; slab < numSlabs; ++slab)
+        numPairs += scratch.slabPairs[slab].size();
+    collisionPairs.reserve(numPairs);
+    for (int slab = 0; slab < numSlabs; ++slab)
+        collisionPairs.insert(collisionPairs.end(), scratch.slabPairs[slab].begin(), scratch.slabPairs[slab].end());
+}
+
+
+/*
+========================================================================================================
+
+SweepAndPrune
+
+========================================================================================================
+*/
+
+/*
+====================================================
+IsEndpointLess
+
+Min endpoints go first on ties, so touching bounds still count as overlapping.
+====================================================
+*/
+static bool IsEndpointLess(const pseudoBody_t& lhs, const pseudoBody_t& rhs) {
+    if (lhs.value != rhs.value)
+        return lhs.value < rhs.value;
+    return lhs.isMin && !rhs.isMin;
+}
+
+/*
+====================================================
+SweepAndPrune::Clear
+====================================================
+*/
+void SweepAndPrune::Clear() {
+    m_axis = 0;
+    m_numBodies = 0;
+    m_endpoints.clear();
+    m_axisPairs.clear();
+    m_axisPairIndices.clear();
+    m_testedBounds.clear();
+    m_isMoved.clear();
+    m_pairs.clear();
+    m_pairAxisIndices.clear();
+    m_addedPairs.clear();
+    m_removedPairs.clear();
+}
+
+/*
+====================================================
+SweepAndPrune::Rebuild
+
+The pairs of the old sweep are reported as ended, every pair found by the new one as started.
+====================================================
+*/
+void SweepAndPrune::Rebuild(const SweptBoundsBuffer& sweptBounds, ThreadPool* threadPool) {
+    const int numBodies = sweptBounds.GetNumBodies();
+    m_removedPairs.insert(m_removedPairs.end(), m_pairs.begin(), m_pairs.end());
+    m_pairs.clear();
+    m_pairAxisIndices.clear();
+    m_axisPairs.clear();
+    m_axisPairIndices.clear();
+    m_numBodies = numBodies;
+
+    // the new axis pairs are tested against the bounds of this step when they are added
+    m_testedBounds.resize(numBodies * 8);
+    if (numBodies > 0)
+        memcpy(m_testedBounds.data(), sweptBounds.GetPackedBounds(0), numBodies * 8 * sizeof(float));
+    m_isMoved.assign(numBodies, 0);
+
+    // Select the axis with the largest extent, it stays fixed until the next rebuild
+    const Bounds& globalBounds = sweptBounds.GetGlobalBounds();
+    const float extentX = globalBounds.WidthX();
+    const float extentY = globalBounds.WidthY();
+    const float extentZ = globalBounds.WidthZ();
+    if (extentX >= extentY && extentX >= extentZ)
+        m_axis = 0;
+    else if (extentY >= extentX && extentY >= extentZ)
+        m_axis = 1;
+    else
+        m_axis = 2;
+
+    const float* mins = sweptBounds.GetMins(m_axis);
+    const float* maxs = sweptBounds.GetMaxs(m_axis);
+    m_endpoints.resize(numBodies * 2);
+    for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
+        m_endpoints[currentBodyIndex * 2 + 0].id = currentBodyIndex;
+        m_endpoints[currentBodyIndex * 2 + 0].value = mins[currentBodyIndex];
+        m_endpoints[currentBodyIndex * 2 + 0].isMin = true;
+
+        m_endpoints[currentBodyIndex * 2 + 1].id = currentBodyIndex;
+        m_endpoints[currentBodyIndex * 2 + 1].value = maxs[currentBodyIndex];
+        m_endpoints[currentBodyIndex * 2 + 1].isMin = false;
+    }
+    RadixSortEndpoints(m_endpoints.data(), static_cast<int>(m_endpoints.size()), m_sweepScratch, threadPool);
+
+    // A full sweep, every overlap found here is a new pair
+    std::vector<collisionPair_t>& sweptPairs = m_sweepScratch.pairs;
+    BuildPairs(sweptPairs, m_endpoints.data(), numBodies, m_sweepScratch, threadPool);
+    for (const collisionPair_t& currentPair : sweptPairs)
+        AddAxisPair(sweptBounds, currentPair.a, currentPair.b);
+}
+
+/*
+====================================================
+SweepAndPrune::AddAxisPair
+====================================================
+*/
+void SweepAndPrune::AddAxisPair(const SweptBoundsBuffer& sweptBounds, const int bodyA, const int bodyB) {
+    // A min endpoint can pass a max endpoint in the middle of the sort without the
+    // final intervals overlapping, so confirm with the bounds of this step
+    const float* mins = sweptBounds.GetMins(m_axis);
+    const float* maxs = sweptBounds.GetMaxs(m_axis);
+    if (maxs[bodyA] < mins[bodyB] || maxs[bodyB] < mins[bodyA])
+        return;
+
+    const uint64_t key = collisionPair_t::GetKey(bodyA, bodyB);
+    if (m_axisPairIndices.find(key) != m_axisPairIndices.end())
+        return;
+
+    axisPair_t axisPair;
+    axisPair.a = std::min(bodyA, bodyB);
+    axisPair.b = std::max(bodyA, bodyB);
+    axisPair.pairIndex = -1;
+
+    const int axisPairIndex = static_cast<int>(m_axisPairs.size());
+    m_axisPairIndices[key] = axisPairIndex;
+    m_axisPairs.push_back(axisPair);
+
+    if (sweptBounds.DoesIntersect(axisPair.a, axisPair.b))
+        AddPair(sweptBounds, axisPairIndex);
+}
+
+/*
+====================================================
+SweepAndPrune::RemoveAxisPair
+====================================================
+*/
+void SweepAndPrune::RemoveAxisPair(const int bodyA, const int bodyB) {
+    auto it = m_axisPairIndices.find(collisionPair_t::GetKey(bodyA, bodyB));
+    if (it == m_axisPairIndices.end())
+        return;
+
+    const int axisPairIndex = it->second;
+    m_axisPairIndices.erase(it);
+    if (-1 != m_axisPairs[axisPairIndex].pairIndex)
+        RemovePair(axisPairIndex);
+
+    // swap with the last pair so the removal stays O(1)
+    const int lastIndex = static_cast<int>(m_axisPairs.size()) - 1;
+    if (axisPairIndex != lastIndex) {
+        const axisPair_t& lastPair = m_axisPairs[lastIndex];
+        m_axisPairs[axisPairIndex] = lastPair;
+        m_axisPairIndices[collisionPair_t::GetKey(lastPair.a, lastPair.b)] = axisPairIndex;
+        if (-1 != lastPair.pairIndex)
+            m_pairAxisIndices[lastPair.pairIndex] = axisPairIndex;
+    }
+    m_axisPairs.pop_back();
+}
+
+/*
+====================================================
+SweepAndPrune::AddPair
+
+The axis pair started to overlap on all three axes
+====================================================
+*/
+void SweepAndPrune::AddPair(const SweptBoundsBuffer& sweptBounds, const int axisPairIndex) {
+    axisPair_t& axisPair = m_axisPairs[axisPairIndex];
+    const int bodyA = sweptBounds.GetBodyId(axisPair.a);
+    const int bodyB = sweptBounds.GetBodyId(axisPair.b);
+
+    collisionPair_t pair;
+    pair.a = std::min(bodyA, bodyB);
+    pair.b = std::max(bodyA, bodyB);
+
+    axisPair.pairIndex = static_cast<int>(m_pairs.size());
+    m_pairs.push_back(pair);
+    m_pairAxisIndices.push_back(axisPairIndex);
+    m_addedPairs.push_back(pair);
+}
+
+/*
+====================================================
+SweepAndPrune::RemovePair
+
+The axis pair stopped to overlap on all three axes
+====================================================
+*/
+void SweepAndPrune::RemovePair(const int axisPairIndex) {
+    axisPair_t& axisPair = m_axisPairs[axisPairIndex];
+    const int pairIndex = axisPair.pairIndex;
+    axisPair.pairIndex = -1;
+    m_removedPairs.push_back(m_pairs[pairIndex]);
+
+    const int lastIndex = static_cast<int>(m_pairs.size()) - 1;
+    if (pairIndex != lastIndex) {
+        m_pairs[pairIndex] = m_pairs[lastIndex];
+        m_pairAxisIndices[pairIndex] = m_pairAxisIndices[lastIndex];
+        m_axisPairs[m_pairAxisIndices[pairIndex]].pairIndex = pairIndex;
+    }
+    m_pairs.pop_back();
+    m_pairAxisIndices.pop_back();
+}
+
+/*
+====================================================
+SweepAndPrune::FindMovedBodies
+
+Bodies whose bounds changed since their axis pairs were last tested
+====================================================
+*/
+void SweepAndPrune::FindMovedBodies(const SweptBoundsBuffer& sweptBounds, ThreadPool* threadPool) {
+    auto findMoved = [&](const int begin, const int end, const int threadIndex) {
+        for (int bodyId = begin; bodyId < end; ++bodyId) {
+            const float* bounds = sweptBounds.GetPackedBounds(bodyId);
+            float* testedBounds = &m_testedBounds[bodyId * 8];
+            m_isMoved[bodyId] = (0 != memcmp(bounds, testedBounds, 8 * sizeof(float))) ? 1 : 0;
+            if (m_isMoved[bodyId])
+                memcpy(testedBounds, bounds, 8 * sizeof(float));
+        }
+    };
+    if (nullptr != threadPool)
+        threadPool->ParallelFor(m_numBodies, PAIRS_PER_CHUNK, findMoved);
+    else
+        findMoved(0, m_numBodies, 0);
+}
+
+/*
+====================================================
+SweepAndPrune::PruneMovedPairs
+
+Box pruning: an axis pair only overlaps differently on the other axes when one of its bodies moved.
+The chunks of axis pairs are tested on the thread pool, each one lists the pairs that changed,
+and the changes are applied in chunk order, so the pair list is the same on any number of threads.
+====================================================
+*/
+void SweepAndPrune::PruneMovedPairs(const SweptBoundsBuffer& sweptBounds, ThreadPool* threadPool) {
+    const int numAxisPairs = static_cast<int>(m_axisPairs.size());
+    const int numChunks = (numAxisPairs + PAIRS_PER_CHUNK - 1) / PAIRS_PER_CHUNK;
+    if (static_cast<int>(m_changedPairs.size()) < numChunks)
+        m_changedPairs.resize(numChunks);
+
+    auto prune = [&](const int begin, const int end, const int threadIndex) {
+        std::vector<int>& changedPairs = m_changedPairs[begin / PAIRS_PER_CHUNK];
+        changedPairs.clear();
+        for (int axisPairIndex = begin; axisPairIndex < end; ++axisPairIndex) {
+            const axisPair_t& axisPair = m_axisPairs[axisPairIndex];
+            if (!m_isMoved[axisPair.a] && !m_isMoved[axisPair.b])
+                continue;
+
+            const bool isOverlapping = sweptBounds.DoesIntersect(axisPair.a, axisPair.b);
+            if (isOverlapping != (-1 != axisPair.pairIndex))
+                changedPairs.push_back(axisPairIndex);
+        }
+    };
+    if (nullptr != threadPool)
+        threadPool->ParallelFor(numAxisPairs, PAIRS_PER_CHUNK, prune);
+    else
+        prune(0, numAxisPairs, 0);
+
+    // only m_pairs is reordered here, the axis pair indices stay valid
+    for (int chunk = 0; chunk < numChunks; ++chunk) {
+        for (const int axisPairIndex : m_changedPairs[chunk]) {
+            if (-1 == m_axisPairs[axisPairIndex].pairIndex)
+                AddPair(sweptBounds, axisPairIndex);
+            else
+                RemovePair(axisPairIndex);
+        }
+    }
+}
+
+/*
+====================================================
+SweepAndPrune::Update
 
-            // Remove the exiting body from the Active List.
-            // Using std::remove_if + erase idiom for safety and correctness.
-            auto it = std::remove_if(activeList.begin(), activeList.end(),
-                [bodyId](int id) { return id == bodyId; });
-            activeList.erase(it, activeList.end());
+The insertion sort runs on the calling thread, the bounds checks of the moved bodies and pairs on the thread pool.
+====================================================
+*/
+void SweepAndPrune::Update(const SweptBoundsBuffer& sweptBounds, ThreadPool* threadPool) {
+    m_addedPairs.clear();
+    m_removedPairs.clear();
+
+    if (sweptBounds.GetNumBodies() != m_numBodies || m_endpoints.empty()) {
+        Rebuild(sweptBounds, threadPool);
+        return;
+    }
+
+    // new axis pairs are tested right away, the ones that ended leave the pair list with them
+    FindMovedBodies(sweptBounds, threadPool);
+    SortEndpoints(sweptBounds);
+    PruneMovedPairs(sweptBounds, threadPool);
+}
+
+/*
+====================================================
+SweepAndPrune::SortEndpoints
+====================================================
+*/
+void SweepAndPrune::SortEndpoints(const SweptBoundsBuffer& sweptBounds) {
+    const float* mins = sweptBounds.GetMins(m_axis);
+    const float* maxs = sweptBounds.GetMaxs(m_axis);
+    for (pseudoBody_t& currentEndpoint : m_endpoints)
+        currentEndpoint.value = currentEndpoint.isMin ? mins[currentEndpoint.id] : maxs[currentEndpoint.id];
+
+    // Insertion sort: the list is nearly sorted from the last step, so this is close to O(N + swaps).
+    // Each pair of endpoints swaps at most once and only min/max swaps can change an overlap.
+    const int numEndpoints = static_cast<int>(m_endpoints.size());
+    for (int currentIndex = 1; currentIndex < numEndpoints; ++currentIndex) {
+        const pseudoBody_t movingEndpoint = m_endpoints[currentIndex];
+
+        int targetIndex = currentIndex - 1;
+        while (targetIndex >= 0 && IsEndpointLess(movingEndpoint, m_endpoints[targetIndex])) {
+            const pseudoBody_t& passedEndpoint = m_endpoints[targetIndex];
+
+            if (movingEndpoint.isMin && !passedEndpoint.isMin) {
+                // a min moved before a max: the intervals may have started overlapping
+                AddAxisPair(sweptBounds, movingEndpoint.id, passedEndpoint.id);
+            }
+            else if (!movingEndpoint.isMin && passedEndpoint.isMin) {
+                // a max moved before a min: the intervals stopped overlapping
+                RemoveAxisPair(movingEndpoint.id, passedEndpoint.id);
+            }
+
+            m_endpoints[targetIndex + 1] = passedEndpoint;
+            --targetIndex;
         }
+        m_endpoints[targetIndex + 1] = movingEndpoint;
     }
 }
-void SweepAndPrune1D(const Body* bodies, const int numBodies, std::vector<collisionPair_t>& finalPairs, const float deltaSecond) {
-    // reserve space on the stack for 2 endpoints per body.
-    std::vector<pseudoBody_t> sortedBodies(numBodies * 2);
 
-    SortBodiesBounds(bodies, numBodies, sortedBodies.data(), deltaSecond);
 
-    // The core issue was here: BuildPairs was doing an O(N^2) scan instead of using the Active List.
-    BuildPairs(finalPairs, sortedBodies.data(), numBodies);
+/*
+========================================================================================================
+
+TreeBroadPhase
+
+========================================================================================================
+*/
+
+/*
+====================================================
+TreeBroadPhase::Clear
+====================================================
+*/
+void TreeBroadPhase::Clear() {
+    m_tree.Clear();
+    m_proxies.clear();
+    m_queryResults.clear();
+    m_pairs.clear();
+    m_numRejectedPairs = 0;
+}
+
+/*
+====================================================
+TreeBroadPhase::Update
+====================================================
+*/
+void TreeBroadPhase::Update(const SweptBoundsBuffer& sweptBounds) {
+    const int numBodies = sweptBounds.GetNumBodies();
+    if (numBodies != static_cast<int>(m_proxies.size())) {
+        m_tree.Clear();
+        m_proxies.resize(numBodies);
+        for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex)
+            m_proxies[currentBodyIndex] = m_tree.CreateProxy(sweptBounds.GetBounds(currentBodyIndex), currentBodyIndex);
+    }
+    else {
+        // only the bodies that left their fat bounds touch the tree
+        for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex)
+            m_tree.MoveProxy(m_proxies[currentBodyIndex], sweptBounds.GetBounds(currentBodyIndex));
+    }
+
+    // The tight bounds of A against the fat bounds of B catch every tight overlap,
+    // so each pair only has to be reported from its lower id
+    m_pairs.clear();
+    m_numRejectedPairs = 0;
+    for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
+        m_queryResults.clear();
+        m_tree.Query(sweptBounds.GetBounds(currentBodyIndex), m_queryResults);
+
+        for (const int otherBodyIndex : m_queryResults) {
+            if (otherBodyIndex <= currentBodyIndex)
+                continue;
+
+            // the fat bounds overlap, make sure the tight bounds do too
+            if (!sweptBounds.DoesIntersect(currentBodyIndex, otherBodyIndex)) {
+                ++m_numRejectedPairs;
+                continue;
+            }
+
+            collisionPair_t pair;
+            pair.a = currentBodyIndex;
+            pair.b = otherBodyIndex;
+            m_pairs.push_back(pair);
+        }
+    }
+}
+
+
+/*
+========================================================================================================
+
+GridBroadPhase
+
+========================================================================================================
+*/
+
+/*
+====================================================
+GetCellCoordinate
+====================================================
+*/
+static int GetCellCoordinate(const float value, const float invCellSize) {
+    // clamp so bodies that were flung far away can't overflow the integer coordinates
+    const float cell = std::floor(value * invCellSize);
+    return static_cast<int>(std::max(-1.0e9f, std::min(1.0e9f, cell)));
+}
+
+/*
+====================================================
+GetCellHash
+====================================================
+*/
+static int GetCellHash(const gridEntry_t& entry, const int bucketMask) {
+    const uint32_t hash = (static_cast<uint32_t>(entry.cellX) * 73856093u) ^ (static_cast<uint32_t>(entry.cellY) * 19349663u) ^
+        (static_cast<uint32_t>(entry.cellZ) * 83492791u) ^ (static_cast<uint32_t>(entry.level) * 2654435761u);
+    return static_cast<int>(hash & static_cast<uint32_t>(bucketMask));
+}
+
+/*
+====================================================
+SortEntriesIntoBuckets
+
+Counting sort of the grid entries by cell hash, all the storage is reused between steps.
+Returns the bucket mask, bucket i spans [bucketStarts[i], bucketStarts[i + 1]) of sortedEntries.
+====================================================
+*/
+static int SortEntriesIntoBuckets(const std::vector<gridEntry_t>& entries, std::vector<gridEntry_t>& sortedEntries, std::vector<int>& bucketStarts, std::vector<int>& bucketCursors) {
+    int numBuckets = 64;
+    while (numBuckets < static_cast<int>(entries.size()) * 2)
+        numBuckets *= 2;
+    const int bucketMask = numBuckets - 1;
+
+    bucketStarts.assign(numBuckets + 1, 0);
+    for (const gridEntry_t& currentEntry : entries)
+        ++bucketStarts[GetCellHash(currentEntry, bucketMask) + 1];
+    for (int currentBucket = 0; currentBucket < numBuckets; ++currentBucket)
+        bucketStarts[currentBucket + 1] += bucketStarts[currentBucket];
+
+    bucketCursors.assign(bucketStarts.begin(), bucketStarts.end() - 1);
+    sortedEntries.resize(entries.size());
+    for (const gridEntry_t& currentEntry : entries)
+        sortedEntries[bucketCursors[GetCellHash(currentEntry, bucketMask)]++] = currentEntry;
+
+    return bucketMask;
+}
+
+/*
+====================================================
+GridBroadPhase::Clear
+====================================================
+*/
+void GridBroadPhase::Clear() {
+    m_cellSize = 1.0f;
+    m_extents.clear();
+    m_oversizedBodies.clear();
+    m_entries.clear();
+    m_sortedEntries.clear();
+    m_bucketStarts.clear();
+    m_bucketCursors.clear();
+    m_pairs.clear();
+}
+
+/*
+====================================================
+GridBroadPhase::Update
+====================================================
+*/
+void GridBroadPhase::Update(const SweptBoundsBuffer& sweptBounds) {
+    const int numBodies = sweptBounds.GetNumBodies();
+    m_pairs.clear();
+    m_entries.clear();
+    m_oversizedBodies.clear();
+    if (numBodies <= 0)
+        return;
+
+    // --- 1. The cell size from the median extent ---
+    m_extents.resize(numBodies);
+    for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex)
+        m_extents[currentBodyIndex] = sweptBounds.GetMaxExtent(currentBodyIndex);
+    std::nth_element(m_extents.begin(), m_extents.begin() + numBodies / 2, m_extents.end());
+    m_cellSize = std::max(m_extents[numBodies / 2], 0.01f);
+    const float invCellSize = 1.0f / m_cellSize;
+
+    // --- 2. One entry per covered cell ---
+    for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
+        const Bounds bounds = sweptBounds.GetBounds(currentBodyIndex);
+        const int minX = GetCellCoordinate(bounds.mins.x, invCellSize);
+        const int minY = GetCellCoordinate(bounds.mins.y, invCellSize);
+        const int minZ = GetCellCoordinate(bounds.mins.z, invCellSize);
+        const int maxX = GetCellCoordinate(bounds.maxs.x, invCellSize);
+        const int maxY = GetCellCoordinate(bounds.maxs.y, invCellSize);
+        const int maxZ = GetCellCoordinate(bounds.maxs.z, invCellSize);
+
+        if (maxX - minX >= MAX_CELLS_PER_AXIS || maxY - minY >= MAX_CELLS_PER_AXIS || maxZ - minZ >= MAX_CELLS_PER_AXIS) {
+            m_oversizedBodies.push_back(currentBodyIndex);
+            continue;
+        }
+
+        for (int cellX = minX; cellX <= maxX; ++cellX) {
+            for (int cellY = minY; cellY <= maxY; ++cellY) {
+                for (int cellZ = minZ; cellZ <= maxZ; ++cellZ) {
+                    gridEntry_t entry;
+                    entry.id = currentBodyIndex;
+                    entry.level = 0;
+                    entry.cellX = cellX;
+                    entry.cellY = cellY;
+                    entry.cellZ = cellZ;
+                    m_entries.push_back(entry);
+                }
+            }
+        }
+    }
+
+    // --- 3. Counting sort the entries into buckets ---
+    const int numBuckets = SortEntriesIntoBuckets(m_entries, m_sortedEntries, m_bucketStarts, m_bucketCursors) + 1;
+
+    // --- 4. Pairs inside each cell ---
+    const float* minsX = sweptBounds.GetMins(0);
+    const float* minsY = sweptBounds.GetMins(1);
+    const float* minsZ = sweptBounds.GetMins(2);
+    for (int currentBucket = 0; currentBucket < numBuckets; ++currentBucket) {
+        const int bucketStart = m_bucketStarts[currentBucket];
+        const int bucketEnd = m_bucketStarts[currentBucket + 1];
+
+        for (int entryIndexA = bucketStart; entryIndexA < bucketEnd; ++entryIndexA) {
+            const gridEntry_t& entryA = m_sortedEntries[entryIndexA];
+            for (int entryIndexB = entryIndexA + 1; entryIndexB < bucketEnd; ++entryIndexB) {
+                const gridEntry_t& entryB = m_sortedEntries[entryIndexB];
+
+                // different cells that happen to share a bucket
+                if (entryA.cellX != entryB.cellX || entryA.cellY != entryB.cellY || entryA.cellZ != entryB.cellZ)
+                    continue;
+
+                if (!sweptBounds.DoesIntersect(entryA.id, entryB.id))
+                    continue;
+
+                // Bodies can share several cells, only report the pair from the cell holding the min corner of the overlap
+                if (GetCellCoordinate(std::max(minsX[entryA.id], minsX[entryB.id]), invCellSize) != entryA.cellX ||
+                    GetCellCoordinate(std::max(minsY[entryA.id], minsY[entryB.id]), invCellSize) != entryA.cellY ||
+                    GetCellCoordinate(std::max(minsZ[entryA.id], minsZ[entryB.id]), invCellSize) != entryA.cellZ)
+                    continue;
+
+                collisionPair_t pair;
+                pair.a = std::min(entryA.id, entryB.id);
+                pair.b = std::max(entryA.id, entryB.id);
+                m_pairs.push_back(pair);
+            }
+        }
+    }
+
+    // --- 5. Oversized bodies against everything ---
+    for (const int oversizedBody : m_oversizedBodies) {
+        for (int otherBody = 0; otherBody < numBodies; ++otherBody) {
+            if (otherBody == oversizedBody)
+                continue;
+
+            // a pair of two oversized bodies is reported once, from the lower id
+            const bool isOtherOversized = std::binary_search(m_oversizedBodies.begin(), m_oversizedBodies.end(), otherBody);
+            if (isOtherOversized && otherBody < oversizedBody)
+                continue;
+
+            if (!sweptBounds.DoesIntersect(oversizedBody, otherBody))
+                continue;
+
+            collisionPair_t pair;
+            pair.a = std::min(oversizedBody, otherBody);
+            pair.b = std::max(oversizedBody, otherBody);
+            m_pairs.push_back(pair);
+        }
+    }
+}
+
+
+/*
+========================================================================================================
+
+HierarchicalGridBroadPhase
+
+========================================================================================================
+*/
+
+/*
+====================================================
+HierarchicalGridBroadPhase::Clear
+====================================================
+*/
+void HierarchicalGridBroadPhase::Clear() {
+    m_baseCellSize = 1.0f;
+    m_occupiedLevels = 0;
+    m_extents.clear();
+    m_levels.clear();
+    m_entries.clear();
+    m_sortedEntries.clear();
+    m_bucketStarts.clear();
+    m_bucketCursors.clear();
+    m_pairs.clear();
+}
+
+/*
+====================================================
+HierarchicalGridBroadPhase::Update
+====================================================
+*/
+void HierarchicalGridBroadPhase::Update(const SweptBoundsBuffer& sweptBounds) {
+    const int numBodies = sweptBounds.GetNumBodies();
+    m_pairs.clear();
+    m_entries.clear();
+    m_occupiedLevels = 0;
+    if (numBodies <= 0)
+        return;
+
+    // --- 1. The base cell size from the median extent ---
+    m_extents.resize(numBodies);
+    m_levels.resize(numBodies);
+    for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex)
+        m_extents[currentBodyIndex] = sweptBounds.GetMaxExtent(currentBodyIndex);
+    std::vector<float>::iterator median = m_extents.begin() + numBodies / 2;
+    std::nth_element(m_extents.begin(), median, m_extents.end());
+    m_baseCellSize = std::max(*median, 0.01f);
+
+    // --- 2. Store every body at the level that fits it ---
+    for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
+        const Bounds bounds = sweptBounds.GetBounds(currentBodyIndex);
+        const float extent = sweptBounds.GetMaxExtent(currentBodyIndex);
+
+        int level = 0;
+        while (level < MAX_LEVELS - 1 && GetCellSize(level) < extent)
+            ++level;
+        m_levels[currentBodyIndex] = level;
+        m_occupiedLevels |= (1u << level);
+
+        const float invCellSize = 1.0f / GetCellSize(level);
+        const int minX = GetCellCoordinate(bounds.mins.x, invCellSize);
+        const int minY = GetCellCoordinate(bounds.mins.y, invCellSize);
+        const int minZ = GetCellCoordinate(bounds.mins.z, invCellSize);
+        const int maxX = GetCellCoordinate(bounds.maxs.x, invCellSize);
+        const int maxY = GetCellCoordinate(bounds.maxs.y, invCellSize);
+        const int maxZ = GetCellCoordinate(bounds.maxs.z, invCellSize);
+
+        for (int cellX = minX; cellX <= maxX; ++cellX) {
+            for (int cellY = minY; cellY <= maxY; ++cellY) {
+                for (int cellZ = minZ; cellZ <= maxZ; ++cellZ) {
+                    gridEntry_t entry;
+                    entry.id = currentBodyIndex;
+                    entry.level = level;
+                    entry.cellX = cellX;
+                    entry.cellY = cellY;
+                    entry.cellZ = cellZ;
+                    m_entries.push_back(entry);
+                }
+            }
+        }
+    }
+
+    // --- 3. Counting sort the entries into buckets ---
+    const int bucketMask = SortEntriesIntoBuckets(m_entries, m_sortedEntries, m_bucketStarts, m_bucketCursors);
+
+    // --- 4. Each body against its own level and the coarser ones ---
+    const float* minsX = sweptBounds.GetMins(0);
+    const float* minsY = sweptBounds.GetMins(1);
+    const float* minsZ = sweptBounds.GetMins(2);
+    for (int bodyA = 0; bodyA < numBodies; ++bodyA) {
+        const Bounds boundsA = sweptBounds.GetBounds(bodyA);
+
+        for (int level = m_levels[bodyA]; level < MAX_LEVELS; ++level) {
+            if (0 == (m_occupiedLevels & (1u << level)))
+                continue;
+
+            const bool isSameLevel = (level == m_levels[bodyA]);
+            const float invCellSize = 1.0f / GetCellSize(level);
+
+            gridEntry_t cell;
+            cell.id = bodyA;
+            cell.level = level;
+            const int minX = GetCellCoordinate(boundsA.mins.x, invCellSize);
+            const int minY = GetCellCoordinate(boundsA.mins.y, invCellSize);
+            const int minZ = GetCellCoordinate(boundsA.mins.z, invCellSize);
+            const int maxX = GetCellCoordinate(boundsA.maxs.x, invCellSize);
+            const int maxY = GetCellCoordinate(boundsA.maxs.y, invCellSize);
+            const int maxZ = GetCellCoordinate(boundsA.maxs.z, invCellSize);
+
+            for (cell.cellX = minX; cell.cellX <= maxX; ++cell.cellX) {
+                for (cell.cellY = minY; cell.cellY <= maxY; ++cell.cellY) {
+                    for (cell.cellZ = minZ; cell.cellZ <= maxZ; ++cell.cellZ) {
+                        const int bucket = GetCellHash(cell, bucketMask);
+                        for (int entryIndex = m_bucketStarts[bucket]; entryIndex < m_bucketStarts[bucket + 1]; ++entryIndex) {
+                            const gridEntry_t& entryB = m_sortedEntries[entryIndex];
+                            if (entryB.level != level || entryB.cellX != cell.cellX || entryB.cellY != cell.cellY || entryB.cellZ != cell.cellZ)
+                                continue;
+
+                            // bodies on the same level both run this query, so only the lower id reports
+                            const int bodyB = entryB.id;
+                            if (isSameLevel && bodyB <= bodyA)
+                                continue;
+
+                            if (!sweptBounds.DoesIntersect(bodyA, bodyB))
+                                continue;
+
+                            // only report the pair from the cell holding the min corner of the overlap
+                            if (GetCellCoordinate(std::max(boundsA.mins.x, minsX[bodyB]), invCellSize) != cell.cellX ||
+                                GetCellCoordinate(std::max(boundsA.mins.y, minsY[bodyB]), invCellSize) != cell.cellY ||
+                                GetCellCoordinate(std::max(boundsA.mins.z, minsZ[bodyB]), invCellSize) != cell.cellZ)
+                                continue;
+
+                            collisionPair_t pair;
+                            pair.a = std::min(bodyA, bodyB);
+                            pair.b = std::max(bodyA, bodyB);
+                            m_pairs.push_back(pair);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/*
+========================================================================================================
+
+StaticBroadPhase
+
+========================================================================================================
+*/
+
+/*
+====================================================
+StaticBroadPhase::IsStaticBody
+====================================================
+*/
+bool StaticBroadPhase::IsStaticBody(const Body& body) {
+    return 0.0f == body.m_invMass;
+}
+
+/*
+====================================================
+IsMoving
+====================================================
+*/
+static bool IsMoving(const Body& body) {
+    return 0.0f != body.m_linearVelocity.GetLengthSqr() || 0.0f != body.m_angularVelocity.GetLengthSqr();
+}
+
+/*
+====================================================
+StaticBroadPhase::Clear
+====================================================
+*/
+void StaticBroadPhase::Clear() {
+    m_tree.Clear();
+    m_proxies.clear();
+    m_bounds.clear();
+    m_positions.clear();
+    m_orientations.clear();
+    m_dynamicBodies.clear();
+    m_isDynamicSetChanged = false;
+}
+
+/*
+====================================================
+StaticBroadPhase::Update
+====================================================
+*/
+void StaticBroadPhase::Update(const Body* bodies, const int numBodies, const float deltaSecond) {
+    bool isChanged = false;
+    if (numBodies != static_cast<int>(m_proxies.size())) {
+        m_tree.Clear();
+        m_proxies.assign(numBodies, -1);
+        m_bounds.resize(numBodies);
+        m_positions.resize(numBodies);
+        m_orientations.resize(numBodies);
+        isChanged = true;
+    }
+
+    m_dynamicBodies.clear();
+    for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
+        const Body& body = bodies[currentBodyIndex];
+        int& proxy = m_proxies[currentBodyIndex];
+
+        if (!IsStaticBody(body)) {
+            if (-1 != proxy) {
+                // got a mass
+                m_tree.DestroyProxy(proxy);
+                proxy = -1;
+                isChanged = true;
+            }
+            m_dynamicBodies.push_back(currentBodyIndex);
+            continue;
+        }
+
+        // Only a new static body, a moving one or an edited pose (the gizmo) needs its bounds again
+        const bool isMoving = IsMoving(body);
+        const Quat& orientation = m_orientations[currentBodyIndex];
+        const bool isPoseChanged = (body.m_position != m_positions[currentBodyIndex]) ||
+            body.m_orientation.x != orientation.x || body.m_orientation.y != orientation.y ||
+            body.m_orientation.z != orientation.z || body.m_orientation.w != orientation.w;
+        if (-1 != proxy && !isPoseChanged && !isMoving)
+            continue;
+
+        // a moving kinematic body is swept like a dynamic one, the fat tree leaf absorbs most of its motion
+        m_bounds[currentBodyIndex] = SweptBoundsBuffer::ComputeBounds(body, isMoving ? deltaSecond : 0.0f);
+        m_positions[currentBodyIndex] = body.m_position;
+        m_orientations[currentBodyIndex] = body.m_orientation;
+
+        if (-1 == proxy) {
+            proxy = m_tree.CreateProxy(m_bounds[currentBodyIndex], currentBodyIndex);
+            isChanged = true;
+        }
+        else
+            m_tree.MoveProxy(proxy, m_bounds[currentBodyIndex]);
+    }
+    m_isDynamicSetChanged = isChanged;
+}
+
+
+/*
+========================================================================================================
+
+PairCache
+
+========================================================================================================
+*/
+
+/*
+====================================================
+PairCache::Clear
+====================================================
+*/
+void PairCache::Clear() {
+    m_stamp = 0;
+    m_pairs.clear();
+    m_addedPairs.clear();
+    m_removedPairs.clear();
+    m_numSortedRemovedPairs = 0;
+}
+
+/*
+====================================================
+PairCache::BeginUpdate
+====================================================
+*/
+void PairCache::BeginUpdate() {
+    m_addedPairs.clear();
+    m_removedPairs.clear();
+    m_numSortedRemovedPairs = 0;
+    ++m_stamp;
+}
+
+/*
+====================================================
+PairCache::EndAll
+
+A pair that survives the reset is reported as ended and then started again.
+====================================================
+*/
+void PairCache::EndAll(const std::vector<collisionPair_t>& lastPairs) {
+    m_removedPairs.insert(m_removedPairs.end(), lastPairs.begin(), lastPairs.end());
+    m_numSortedRemovedPairs = static_cast<int>(m_removedPairs.size());
+    m_pairs.clear();
+}
+
+/*
+====================================================
+PairCache::AddEvents
+====================================================
+*/
+void PairCache::AddEvents(const std::vector<collisionPair_t>& addedPairs, const std::vector<collisionPair_t>& removedPairs) {
+    m_addedPairs.insert(m_addedPairs.end(), addedPairs.begin(), addedPairs.end());
+    m_removedPairs.insert(m_removedPairs.end(), removedPairs.begin(), removedPairs.end());
+    m_numSortedRemovedPairs = static_cast<int>(m_removedPairs.size());
+}
+
+/*
+====================================================
+PairCache::DiffPairs
+====================================================
+*/
+void PairCache::DiffPairs(const collisionPair_t* pairs, const int numPairs) {
+    for (int pairIndex = 0; pairIndex < numPairs; ++pairIndex) {
+        const collisionPair_t& currentPair = pairs[pairIndex];
+        auto result = m_pairs.emplace(currentPair.GetKey(), m_stamp);
+        if (result.second)
+            m_addedPairs.push_back(currentPair);
+        else
+            result.first->second = m_stamp;
+    }
+}
+
+/*
+====================================================
+PairCache::EndUpdate
+====================================================
+*/
+void PairCache::EndUpdate() {
+    // Every diffed pair that wasn't reported in this update has ended
+    for (auto it = m_pairs.begin(); it != m_pairs.end();) {
+        if (it->second != m_stamp) {
+            m_removedPairs.push_back(collisionPair_t::FromKey(it->first));
+            it = m_pairs.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    // the hash order isn't stable across runs, keep the events deterministic
+    std::sort(m_removedPairs.begin() + m_numSortedRemovedPairs, m_removedPairs.end(), [](const collisionPair_t& lhs, const collisionPair_t& rhs) {
+        return lhs.GetKey() < rhs.GetKey();
+    });
 }
 
 
@@ -140,7 +1164,95 @@ void SweepAndPrune1D(const Body* bodies, const int numBodies, std::vector<collis
 BroadPhase
 ====================================================
 */
-void BroadPhase( const Body * bodies, const int num, std::vector< collisionPair_t > & finalPairs, const float deltaSecond ) {
+const std::vector< collisionPair_t > & BroadPhase( BroadPhaseContext & context, const BroadPhaseType type, const Body * bodies, const int num, const float deltaSecond ) {
+	context.m_isBackendsCleared = false;
+	context.m_pairCache.BeginUpdate();
+	context.m_statics.Update(bodies, num, deltaSecond);
+	if (context.m_statics.IsDynamicSetChanged() || type != context.m_type) {
+		// the local ids held by the backends no longer match the dynamic bodies,
+		// or the selected backend wasn't updated in the last steps
+		context.m_pairCache.EndAll(context.m_pairs);
+		context.ClearBackends();
+		context.m_type = type;
+	}
+
+	SweptBoundsBuffer& sweptBounds = context.m_sweptBounds;
+	sweptBounds.Update(bodies, context.m_statics.GetDynamicBodies(), deltaSecond);
+	context.m_numRejectedPairs = 0;
+
+	// built in place, so the pair list keeps its capacity from step to step
+	std::vector<collisionPair_t>& finalPairs = context.m_pairs;
 	finalPairs.clear();
-	SweepAndPrune1D(bodies, num, finalPairs, deltaSecond);
+
+	// Dynamic against dynamic, the backends other than the SAP hand back local ids
+	const std::vector<collisionPair_t>* localPairs = nullptr;
+	switch (type) {
+	default:
+	case BroadPhaseType::SWEEP_AND_PRUNE:
+		// keeps its pairs in body ids already
+		context.m_sweepAndPrune.Update(sweptBounds, context.m_threadPool);
+		finalPairs = context.m_sweepAndPrune.GetPairs();
+		context.m_pairCache.AddEvents(context.m_sweepAndPrune.GetAddedPairs(), context.m_sweepAndPrune.GetRemovedPairs());
+		context.m_numRejectedPairs = context.m_sweepAndPrune.GetNumRejectedPairs();
+		break;
+	case BroadPhaseType::DYNAMIC_TREE:
+		context.m_tree.Update(sweptBounds);
+		localPairs = &context.m_tree.GetPairs();
+		context.m_numRejectedPairs = context.m_tree.GetNumRejectedPairs();
+		break;
+	case BroadPhaseType::SPATIAL_HASH_GRID:
+		context.m_grid.Update(sweptBounds);
+		localPairs = &context.m_grid.GetPairs();
+		break;
+	case BroadPhaseType::HIERARCHICAL_GRID:
+		context.m_hierarchicalGrid.Update(sweptBounds);
+		localPairs = &context.m_hierarchicalGrid.GetPairs();
+		break;
+	}
+
+	if (nullptr != localPairs) {
+		for (const collisionPair_t& currentPair : *localPairs) {
+			const int bodyA = sweptBounds.GetBodyId(currentPair.a);
+			const int bodyB = sweptBounds.GetBodyId(currentPair.b);
+
+			collisionPair_t pair;
+			pair.a = std::min(bodyA, bodyB);
+			pair.b = std::max(bodyA, bodyB);
+			finalPairs.push_back(pair);
+		}
+	}
+
+	// the pairs without events of their own are diffed against the last step
+	const int numTrackedPairs = (nullptr == localPairs) ? static_cast<int>(finalPairs.size()) : 0;
+
+	// Dynamic against static, static against static is never tested
+	for (int localId = 0; localId < sweptBounds.GetNumBodies(); ++localId) {
+		const int bodyId = sweptBounds.GetBodyId(localId);
+		const Bounds bounds = sweptBounds.GetBounds(localId);
+
+		context.m_staticQueryResults.clear();
+		context.m_statics.Query(bounds, context.m_staticQueryResults);
+		if (context.m_staticQueryResults.empty())
+			continue;
+
+		// the tree hands back fat leaves, confirm the tight bounds in one batch
+		boundsGather_t& staticBounds = context.m_staticQueryBounds;
+		staticBounds.Clear();
+		for (const int staticBodyId : context.m_staticQueryResults)
+			staticBounds.Add(context.m_statics.GetBounds(staticBodyId));
+		const int numHits = staticBounds.Intersect(bounds);
+		context.m_numRejectedPairs += staticBounds.GetCount() - numHits;
+
+		for (int hitIndex = 0; hitIndex < numHits; ++hitIndex) {
+			const int staticBodyId = context.m_staticQueryResults[staticBounds.hits[hitIndex]];
+			collisionPair_t pair;
+			pair.a = std::min(bodyId, staticBodyId);
+			pair.b = std::max(bodyId, staticBodyId);
+			finalPairs.push_back(pair);
+		}
+	}
+
+	context.m_pairCache.DiffPairs(finalPairs.data() + numTrackedPairs, static_cast<int>(finalPairs.size()) - numTrackedPairs);
+	context.m_pairCache.EndUpdate();
+	return finalPairs;
 }
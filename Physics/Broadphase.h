@@ -3,11 +3,28 @@
 //
 #pragma once
 #include "Body.h"
+#include "SweptBounds.h"
+#include "DynamicTree.h"
+#include "ThreadPool.h"
 
 struct collisionPair_t {
 	int a;
 	int b;
 
+	// canonical key, the same for (a, b) and (b, a), so pairs can be hashed
+	uint64_t GetKey() const { return GetKey( a, b ); }
+	static uint64_t GetKey( const int bodyA, const int bodyB ) {
+		const uint32_t low = static_cast< uint32_t >( std::min( bodyA, bodyB ) );
+		const uint32_t high = static_cast< uint32_t >( std::max( bodyA, bodyB ) );
+		return ( static_cast< uint64_t >( high ) << 32 ) | low;
+	}
+	static collisionPair_t FromKey( const uint64_t key ) {
+		collisionPair_t pair;
+		pair.a = static_cast< int >( key & 0xFFFFFFFFu );
+		pair.b = static_cast< int >( key >> 32 );
+		return pair;
+	}
+
 	bool operator == ( const collisionPair_t & rhs ) const {
 		return ( ( ( a == rhs.a ) && ( b == rhs.b ) ) || ( ( a == rhs.b ) && ( b == rhs.a ) ) );
 	}
@@ -22,8 +39,415 @@ struct pseudoBody_t {
 	bool isMin;
 };
 
-int CompareSAP(const void* lhs, const void* rhs);
-void SortBodiesBounds(const Body* bodies, const int numBodies, pseudoBody_t* sortedArray, const float deltaSecond);
-void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const pseudoBody_t* sortedBodies, const int numBodies);
-void SweepAndPrune1D(const Body* bodies, const int numBodies, std::vector<collisionPair_t>& finalPairs, const float deltaSecond);
-void BroadPhase( const Body * bodies, const int numBodies, std::vector< collisionPair_t > & finalPairs, const float deltaSecond);
+/*
+====================================================
+activeList_t
+
+Bodies currently open on the sweep axis. Each body remembers its slot,
+so leaving the list is a swap with the last entry instead of a search.
+====================================================
+*/
+struct activeList_t {
+	std::vector< int > ids;
+	std::vector< int > slots;	// slot of each body in ids, -1 when not active
+
+	void Add( const int bodyId ) {
+		slots[ bodyId ] = static_cast< int >( ids.size() );
+		ids.push_back( bodyId );
+	}
+	void Remove( const int bodyId ) {
+		const int slot = slots[ bodyId ];
+		if ( -1 == slot ) {
+			return;
+		}
+		const int lastId = ids.back();
+		ids[ slot ] = lastId;
+		slots[ lastId ] = slot;
+		ids.pop_back();
+		slots[ bodyId ] = -1;
+	}
+	void Reset() {
+		for ( const int bodyId : ids ) {
+			slots[ bodyId ] = -1;
+		}
+		ids.clear();
+	}
+};
+
+/*
+====================================================
+sweepScratch_t
+
+Working memory of a full sweep, kept by its owner so a rebuild
+does not allocate once the buffers have grown.
+====================================================
+*/
+struct sweepScratch_t {
+	std::vector< pseudoBody_t > sortedEndpoints;			// the other buffer of the radix sort
+	std::vector< int > histograms;							// per chunk, the digit counts of the radix sort
+	std::vector< int > minIndices;							// sorted index of the min endpoint of each body
+	std::vector< std::vector< int > > openBodies;			// per slab, the bodies already open at its start
+	std::vector< std::vector< collisionPair_t > > slabPairs;
+	std::vector< activeList_t > activeLists;				// per thread
+	std::vector< collisionPair_t > pairs;					// the result of the sweep
+};
+
+void RadixSortEndpoints(pseudoBody_t* endpoints, const int numEndpoints, sweepScratch_t& scratch, ThreadPool* threadPool = nullptr);
+void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const pseudoBody_t* sortedBodies, const int numBodies, sweepScratch_t& scratch, ThreadPool* threadPool = nullptr);
+
+/*
+====================================================
+boundsGather_t
+
+Scratch copy of scattered boxes as SoA arrays, so a body can be tested
+against a list of candidates with IntersectBoundsBatch. Keeps its capacity between uses.
+====================================================
+*/
+struct boundsGather_t {
+	std::vector< float > mins[ 3 ];
+	std::vector< float > maxs[ 3 ];
+	std::vector< int > hits;
+
+	void Clear() {
+		for ( int axis = 0; axis < 3; ++axis ) {
+			mins[ axis ].clear();
+			maxs[ axis ].clear();
+		}
+	}
+	void Add( const Bounds & bounds ) {
+		for ( int axis = 0; axis < 3; ++axis ) {
+			mins[ axis ].push_back( bounds.mins[ axis ] );
+			maxs[ axis ].push_back( bounds.maxs[ axis ] );
+		}
+	}
+	void Add( const SweptBoundsBuffer & sweptBounds, const int localId ) {
+		for ( int axis = 0; axis < 3; ++axis ) {
+			mins[ axis ].push_back( sweptBounds.GetMins( axis )[ localId ] );
+			maxs[ axis ].push_back( sweptBounds.GetMaxs( axis )[ localId ] );
+		}
+	}
+	int GetCount() const { return static_cast< int >( mins[ 0 ].size() ); }
+
+	// Tests the bounds against every gathered box, the indices of the overlapping ones end up in hits
+	int Intersect( const Bounds & bounds ) {
+		boundsSoA_t soa;
+		for ( int axis = 0; axis < 3; ++axis ) {
+			soa.mins[ axis ] = mins[ axis ].data();
+			soa.maxs[ axis ] = maxs[ axis ].data();
+		}
+		hits.resize( GetCount() );
+		return IntersectBoundsBatch( bounds, soa, GetCount(), hits.data() );
+	}
+};
+
+/*
+====================================================
+SweepAndPrune
+
+Persistent 1D sweep-and-prune. The endpoint list is kept between steps and
+re-sorted with insertion sort, so a step only pays for the endpoints that moved
+past each other. Each swap that starts or ends an overlap on the sweep axis adds or removes an axis pair.
+The axis pairs that also overlap on the other two axes make up the pair list, which is kept between steps too.
+An axis pair is only tested again when one of its bodies changed its bounds, and every pair
+that enters or leaves the list is reported as an event, so nothing is rebuilt per step.
+====================================================
+*/
+class SweepAndPrune {
+public:
+	SweepAndPrune() : m_axis( 0 ), m_numBodies( 0 ) {}
+
+	void Update( const SweptBoundsBuffer & sweptBounds, ThreadPool * threadPool = nullptr );
+	void Clear();	// For resetting the demo
+
+	// the pairs that overlap on all three axes and the ones that started/stopped to during the last update, in body ids
+	const std::vector< collisionPair_t > & GetPairs() const { return m_pairs; }
+	const std::vector< collisionPair_t > & GetAddedPairs() const { return m_addedPairs; }
+	const std::vector< collisionPair_t > & GetRemovedPairs() const { return m_removedPairs; }
+	int GetNumRejectedPairs() const { return static_cast< int >( m_axisPairs.size() - m_pairs.size() ); }
+
+private:
+	struct axisPair_t {
+		int a;			// local ids
+		int b;
+		int pairIndex;	// slot in m_pairs while the boxes overlap on all three axes, -1 otherwise
+	};
+
+	void Rebuild( const SweptBoundsBuffer & sweptBounds, ThreadPool * threadPool );
+	void SortEndpoints( const SweptBoundsBuffer & sweptBounds );
+	void FindMovedBodies( const SweptBoundsBuffer & sweptBounds, ThreadPool * threadPool );
+	void PruneMovedPairs( const SweptBoundsBuffer & sweptBounds, ThreadPool * threadPool );
+	void AddAxisPair( const SweptBoundsBuffer & sweptBounds, const int bodyA, const int bodyB );
+	void RemoveAxisPair( const int bodyA, const int bodyB );
+	void AddPair( const SweptBoundsBuffer & sweptBounds, const int axisPairIndex );
+	void RemovePair( const int axisPairIndex );
+
+	int m_axis;
+	int m_numBodies;
+	std::vector< pseudoBody_t > m_endpoints;
+
+	// the pairs overlapping on the sweep axis, plus the index of each pair in m_axisPairs for O(1) removal
+	std::vector< axisPair_t > m_axisPairs;
+	std::unordered_map< uint64_t, int > m_axisPairIndices;
+
+	// the bounds each body had when its axis pairs were last tested, packed as in SweptBoundsBuffer
+	std::vector< float > m_testedBounds;
+	std::vector< uint8_t > m_isMoved;	// per body, whether its bounds changed in this update
+
+	// the axis pairs that also overlap on the other two axes, and the axis pair of each of them
+	std::vector< collisionPair_t > m_pairs;
+	std::vector< int > m_pairAxisIndices;
+
+	// events of the last update
+	std::vector< collisionPair_t > m_addedPairs;
+	std::vector< collisionPair_t > m_removedPairs;
+
+	// per chunk of axis pairs, the ones whose 3D overlap changed in this update
+	std::vector< std::vector< int > > m_changedPairs;
+
+	sweepScratch_t m_sweepScratch;	// only used by rebuilds
+
+	static const int PAIRS_PER_CHUNK = 4096;
+};
+
+/*
+====================================================
+TreeBroadPhase
+
+Keeps one fat leaf per body in a DynamicTree. Only bodies that leave their fat
+bounds are reinserted, then every body queries the tree with its tight bounds.
+====================================================
+*/
+class TreeBroadPhase {
+public:
+	TreeBroadPhase() : m_numRejectedPairs( 0 ) {}
+
+	void Update( const SweptBoundsBuffer & sweptBounds );
+	void Clear();	// For resetting the demo
+
+	const std::vector< collisionPair_t > & GetPairs() const { return m_pairs; }
+	int GetNumRejectedPairs() const { return m_numRejectedPairs; }
+
+private:
+	DynamicTree m_tree;
+	std::vector< int > m_proxies;
+	std::vector< int > m_queryResults;
+	std::vector< collisionPair_t > m_pairs;
+	int m_numRejectedPairs;	// fat bounds overlaps that the tight bounds rejected
+};
+
+/*
+====================================================
+GridBroadPhase
+
+Uniform spatial hash grid, the cell size follows the median body extent of each step.
+Bodies spanning too many cells are kept aside and tested against everything instead.
+The bucket storage is reused, so a step does not allocate once the arrays have grown.
+====================================================
+*/
+struct gridEntry_t {
+	int id;
+	int level;		// always 0 for the uniform grid
+	int cellX;
+	int cellY;
+	int cellZ;
+};
+
+class GridBroadPhase {
+public:
+	GridBroadPhase() : m_cellSize( 1.0f ) {}
+
+	void Update( const SweptBoundsBuffer & sweptBounds );
+	void Clear();	// For resetting the demo
+
+	const std::vector< collisionPair_t > & GetPairs() const { return m_pairs; }
+
+	static const int MAX_CELLS_PER_AXIS = 4;
+
+private:
+	float m_cellSize;
+	std::vector< float > m_extents;
+	std::vector< int > m_oversizedBodies;
+
+	std::vector< gridEntry_t > m_entries;
+	std::vector< gridEntry_t > m_sortedEntries;
+	std::vector< int > m_bucketStarts;
+	std::vector< int > m_bucketCursors;
+
+	std::vector< collisionPair_t > m_pairs;
+};
+
+/*
+====================================================
+HierarchicalGridBroadPhase
+
+Stack of hash grids where each level doubles the cell size of the one below.
+A body is stored at the level whose cells are at least as large as the body,
+so it covers at most two cells per axis no matter how big it is.
+A body queries its own level and the coarser ones, which finds every pair once.
+====================================================
+*/
+class HierarchicalGridBroadPhase {
+public:
+	HierarchicalGridBroadPhase() : m_baseCellSize( 1.0f ), m_occupiedLevels( 0 ) {}
+
+	void Update( const SweptBoundsBuffer & sweptBounds );
+	void Clear();	// For resetting the demo
+
+	const std::vector< collisionPair_t > & GetPairs() const { return m_pairs; }
+	float GetCellSize( const int level ) const { return std::ldexp( m_baseCellSize, level ); }
+
+	static const int MAX_LEVELS = 24;
+
+private:
+	float m_baseCellSize;
+	uint32_t m_occupiedLevels;	// bit per level that holds at least one body
+	std::vector< float > m_extents;
+	std::vector< int > m_levels;
+
+	std::vector< gridEntry_t > m_entries;
+	std::vector< gridEntry_t > m_sortedEntries;
+	std::vector< int > m_bucketStarts;
+	std::vector< int > m_bucketCursors;
+
+	std::vector< collisionPair_t > m_pairs;
+};
+
+/*
+====================================================
+StaticBroadPhase
+
+Bodies with no inverse mass are never moved by contacts, so they are kept out of the per-step work.
+Their bounds are computed when they become static or when their pose is edited,
+and they live in their own tree that the dynamic bodies query.
+Kinematic bodies (no inverse mass but a velocity, like the mover) stay in the tree too,
+their leaf is refit every step they move, so starting or stopping never changes the dynamic set.
+====================================================
+*/
+class StaticBroadPhase {
+public:
+	StaticBroadPhase() : m_isDynamicSetChanged( false ) {}
+
+	void Update( const Body * bodies, const int numBodies, const float deltaSecond );
+	void Clear();	// For resetting the demo
+
+	void Query( const Bounds & bounds, std::vector< int > & bodyIds ) { m_tree.Query( bounds, bodyIds ); }
+
+	const Bounds & GetBounds( const int bodyId ) const { return m_bounds[ bodyId ]; }
+	const std::vector< int > & GetDynamicBodies() const { return m_dynamicBodies; }
+
+	// true when the list of dynamic bodies differs from the last update
+	bool IsDynamicSetChanged() const { return m_isDynamicSetChanged; }
+
+	static bool IsStaticBody( const Body & body );
+
+private:
+	DynamicTree m_tree;
+	std::vector< int > m_proxies;		// tree proxy of each static body, -1 for the dynamic ones
+	std::vector< Bounds > m_bounds;		// bounds of the static bodies
+	std::vector< Vec3 > m_positions;	// pose the static bounds were computed with
+	std::vector< Quat > m_orientations;
+
+	std::vector< int > m_dynamicBodies;
+	bool m_isDynamicSetChanged;
+};
+
+/*
+====================================================
+PairCache
+
+Reports the pairs that started and ended overlapping in the last step, so later stages can work on the changes only.
+A backend that tracks its own pairs (the SAP) hands over its events as they are, the other pairs are
+diffed against the set of the last step, keyed on the canonical pair key.
+====================================================
+*/
+class PairCache {
+public:
+	PairCache() : m_stamp( 0 ), m_numSortedRemovedPairs( 0 ) {}
+
+	void BeginUpdate();
+	void EndAll( const std::vector< collisionPair_t > & lastPairs );	// the backends started over, every pair of the last step has ended
+	void AddEvents( const std::vector< collisionPair_t > & addedPairs, const std::vector< collisionPair_t > & removedPairs );
+	void DiffPairs( const collisionPair_t * pairs, const int numPairs );
+	void EndUpdate();
+	void Clear();	// For resetting the demo
+
+	const std::vector< collisionPair_t > & GetAddedPairs() const { return m_addedPairs; }
+	const std::vector< collisionPair_t > & GetRemovedPairs() const { return m_removedPairs; }
+
+private:
+	uint32_t m_stamp;
+	std::unordered_map< uint64_t, uint32_t > m_pairs;	// diffed pair key -> the last update that reported it
+
+	std::vector< collisionPair_t > m_addedPairs;
+	std::vector< collisionPair_t > m_removedPairs;
+	int m_numSortedRemovedPairs;	// the removed pairs before this one came in a deterministic order
+};
+
+/*
+====================================================
+BroadPhaseContext
+
+Persistent data of every broadphase backend, only the selected one is updated.
+The backends only see the dynamic bodies, the static ones are handled by m_statics.
+The swept bounds of the dynamic bodies are computed once per step and shared with
+the backends and later stages (indexed locally, see SweptBoundsBuffer::GetBodyId).
+====================================================
+*/
+enum class BroadPhaseType {
+	SWEEP_AND_PRUNE,
+	DYNAMIC_TREE,
+	SPATIAL_HASH_GRID,
+	HIERARCHICAL_GRID
+};
+
+class BroadPhaseContext {
+public:
+	BroadPhaseContext() : m_threadPool( nullptr ), m_type( BroadPhaseType::SWEEP_AND_PRUNE ), m_isBackendsCleared( false ), m_numRejectedPairs( 0 ) {}
+
+	void Clear() {
+		m_numRejectedPairs = 0;
+		m_pairs.clear();
+		m_sweptBounds.Clear();
+		m_statics.Clear();
+		m_pairCache.Clear();
+		ClearBackends();
+	}
+	void ClearBackends() {
+		m_isBackendsCleared = true;
+		m_sweepAndPrune.Clear();
+		m_tree.Clear();
+		m_grid.Clear();
+		m_hierarchicalGrid.Clear();
+	}
+
+	SweptBoundsBuffer m_sweptBounds;
+	StaticBroadPhase m_statics;
+	SweepAndPrune m_sweepAndPrune;
+	TreeBroadPhase m_tree;
+	GridBroadPhase m_grid;
+	HierarchicalGridBroadPhase m_hierarchicalGrid;
+
+	// pairs that started/ended overlapping this step, whatever the backend
+	PairCache m_pairCache;
+
+	std::vector< int > m_staticQueryResults;
+	boundsGather_t m_staticQueryBounds;
+
+	// not owned, usually shared with the narrowphase. Without one the broadphase runs on the calling thread
+	ThreadPool * m_threadPool;
+
+	// the pairs returned by BroadPhase, in body ids
+	std::vector< collisionPair_t > m_pairs;
+
+	// the backend of the last step, switching starts the backends over
+	BroadPhaseType m_type;
+
+	// set when the last BroadPhase had to start the backends over, whatever later stages keep per pair should go as well
+	bool m_isBackendsCleared;
+
+	// candidate pairs of the last step that were dropped by the full 3D bounds test
+	int m_numRejectedPairs;
+};
+
+// Returns the pairs of this step, in body ids. The list is owned by the context and valid until the next call
+const std::vector< collisionPair_t > & BroadPhase( BroadPhaseContext & context, const BroadPhaseType type, const Body * bodies, const int numBodies, const float deltaSecond );
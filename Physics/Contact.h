@@ -4,6 +4,12 @@
 #pragma once
 #include "Body.h"
 
+// the most contacts a pair of shapes generates in one step, as many as a manifold holds
+static const int MAX_MANIFOLD_CONTACTS = 4;
+
+// shapes closer than this count as touching, the same slack for the GJK, box-box and convex SAT paths
+static const float CONTACT_BIAS = 0.001f;
+
 struct contact_t {
 	Vec3 ptOnA_WorldSpace;
 	Vec3 ptOnB_WorldSpace;
@@ -0,0 +1,392 @@
+//
+//  DynamicTree.cpp
+//
+#include "PCH.h"
+#include "DynamicTree.h"
+
+// how much the leaf bounds are inflated, bodies can move this far before their leaf is reinserted
+const float DynamicTree::FAT_MARGIN = 0.1f;
+
+/*
+====================================================
+GetUnion
+====================================================
+*/
+static Bounds GetUnion(const Bounds& lhs, const Bounds& rhs) {
+	Bounds result = lhs;
+	result.Expand(rhs);
+	return result;
+}
+
+/*
+====================================================
+DynamicTree::DynamicTree
+====================================================
+*/
+DynamicTree::DynamicTree() :
+	m_root(-1),
+	m_freeList(-1) {
+}
+
+/*
+====================================================
+DynamicTree::Clear
+====================================================
+*/
+void DynamicTree::Clear() {
+	m_nodes.clear();
+	m_root = -1;
+	m_freeList = -1;
+}
+
+/*
+====================================================
+DynamicTree::AllocateNode
+====================================================
+*/
+int DynamicTree::AllocateNode() {
+	int nodeId = m_freeList;
+	if (-1 != nodeId)
+		m_freeList = m_nodes[nodeId].parent;
+	else {
+		nodeId = static_cast<int>(m_nodes.size());
+		m_nodes.push_back(treeNode_t());
+	}
+
+	treeNode_t& node = m_nodes[nodeId];
+	node.bounds.Clear();
+	node.parent = -1;
+	node.left = -1;
+	node.right = -1;
+	node.height = 0;
+	node.bodyId = -1;
+	return nodeId;
+}
+
+/*
+====================================================
+DynamicTree::FreeNode
+====================================================
+*/
+void DynamicTree::FreeNode(const int nodeId) {
+	m_nodes[nodeId].parent = m_freeList;
+	m_nodes[nodeId].height = -1;
+	m_freeList = nodeId;
+}
+
+/*
+====================================================
+DynamicTree::CreateProxy
+====================================================
+*/
+int DynamicTree::CreateProxy(const Bounds& bounds, const int bodyId) {
+	const int proxyId = AllocateNode();
+
+	treeNode_t& leaf = m_nodes[proxyId];
+	leaf.bounds = bounds;
+	leaf.bounds.Expand(bounds.mins - Vec3(FAT_MARGIN));
+	leaf.bounds.Expand(bounds.maxs + Vec3(FAT_MARGIN));
+	leaf.bodyId = bodyId;
+
+	InsertLeaf(proxyId);
+	return proxyId;
+}
+
+/*
+====================================================
+DynamicTree::DestroyProxy
+====================================================
+*/
+void DynamicTree::DestroyProxy(const int proxyId) {
+	RemoveLeaf(proxyId);
+	FreeNode(proxyId);
+}
+
+/*
+====================================================
+DynamicTree::MoveProxy
+
+Returns true if the leaf had to be reinserted.
+====================================================
+*/
+bool DynamicTree::MoveProxy(const int proxyId, const Bounds& bounds) {
+	if (m_nodes[proxyId].bounds.Contains(bounds))
+		return false;
+
+	RemoveLeaf(proxyId);
+
+	treeNode_t& leaf = m_nodes[proxyId];
+	leaf.bounds = bounds;
+	leaf.bounds.Expand(bounds.mins - Vec3(FAT_MARGIN));
+	leaf.bounds.Expand(bounds.maxs + Vec3(FAT_MARGIN));
+
+	InsertLeaf(proxyId);
+	return true;
+}
+
+/*
+====================================================
+DynamicTree::InsertLeaf
+====================================================
+*/
+void DynamicTree::InsertLeaf(const int leafId) {
+	if (-1 == m_root) {
+		m_root = leafId;
+		m_nodes[leafId].parent = -1;
+		return;
+	}
+
+	// Find the best sibling by walking down the cheapest path of the surface area heuristic
+	const Bounds leafBounds = m_nodes[leafId].bounds;
+	int currentIndex = m_root;
+	while (!m_nodes[currentIndex].IsLeaf()) {
+		const treeNode_t& currentNode = m_nodes[currentIndex];
+		const int left = currentNode.left;
+		const int right = currentNode.right;
+
+		const float area = currentNode.bounds.GetSurfaceArea();
+		const float combinedArea = GetUnion(currentNode.bounds, leafBounds).GetSurfaceArea();
+
+		// cost of creating a new parent for this node and the new leaf
+		const float cost = 2.0f * combinedArea;
+		// minimum cost of pushing the leaf further down the tree
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float costLeft = GetUnion(m_nodes[left].bounds, leafBounds).GetSurfaceArea() + inheritanceCost;
+		if (!m_nodes[left].IsLeaf())
+			costLeft -= m_nodes[left].bounds.GetSurfaceArea();
+
+		float costRight = GetUnion(m_nodes[right].bounds, leafBounds).GetSurfaceArea() + inheritanceCost;
+		if (!m_nodes[right].IsLeaf())
+			costRight -= m_nodes[right].bounds.GetSurfaceArea();
+
+		if (cost < costLeft && cost < costRight)
+			break;
+
+		currentIndex = (costLeft < costRight) ? left : right;
+	}
+	const int siblingId = currentIndex;
+
+	// Create a new parent for the sibling and the leaf (this may grow m_nodes, so no references above this line)
+	const int oldParentId = m_nodes[siblingId].parent;
+	const int newParentId = AllocateNode();
+	treeNode_t& newParent = m_nodes[newParentId];
+	newParent.parent = oldParentId;
+	newParent.bounds = GetUnion(leafBounds, m_nodes[siblingId].bounds);
+	newParent.height = m_nodes[siblingId].height + 1;
+	newParent.left = siblingId;
+	newParent.right = leafId;
+
+	if (-1 != oldParentId) {
+		if (m_nodes[oldParentId].left == siblingId)
+			m_nodes[oldParentId].left = newParentId;
+		else
+			m_nodes[oldParentId].right = newParentId;
+	}
+	else
+		m_root = newParentId;
+
+	m_nodes[siblingId].parent = newParentId;
+	m_nodes[leafId].parent = newParentId;
+
+	// Walk back up the tree fixing heights and bounds
+	Refit(m_nodes[leafId].parent);
+}
+
+/*
+====================================================
+DynamicTree::RemoveLeaf
+====================================================
+*/
+void DynamicTree::RemoveLeaf(const int leafId) {
+	if (leafId == m_root) {
+		m_root = -1;
+		return;
+	}
+
+	const int parentId = m_nodes[leafId].parent;
+	const int grandParentId = m_nodes[parentId].parent;
+	const int siblingId = (m_nodes[parentId].left == leafId) ? m_nodes[parentId].right : m_nodes[parentId].left;
+
+	// Destroy the parent and connect the sibling to the grand parent
+	if (-1 != grandParentId) {
+		if (m_nodes[grandParentId].left == parentId)
+			m_nodes[grandParentId].left = siblingId;
+		else
+			m_nodes[grandParentId].right = siblingId;
+		m_nodes[siblingId].parent = grandParentId;
+		FreeNode(parentId);
+
+		Refit(grandParentId);
+	}
+	else {
+		m_root = siblingId;
+		m_nodes[siblingId].parent = -1;
+		FreeNode(parentId);
+	}
+}
+
+/*
+====================================================
+DynamicTree::Refit
+====================================================
+*/
+void DynamicTree::Refit(int nodeId) {
+	while (-1 != nodeId) {
+		nodeId = Balance(nodeId);
+
+		treeNode_t& node = m_nodes[nodeId];
+		const treeNode_t& left = m_nodes[node.left];
+		const treeNode_t& right = m_nodes[node.right];
+
+		node.height = 1 + std::max(left.height, right.height);
+		node.bounds = GetUnion(left.bounds, right.bounds);
+
+		nodeId = node.parent;
+	}
+}
+
+/*
+====================================================
+DynamicTree::Balance
+
+Performs a left or right rotation if the node is imbalanced.
+Returns the new root of the subtree.
+====================================================
+*/
+int DynamicTree::Balance(const int indexA) {
+	treeNode_t& nodeA = m_nodes[indexA];
+	if (nodeA.IsLeaf() || nodeA.height < 2)
+		return indexA;
+
+	const int indexB = nodeA.left;
+	const int indexC = nodeA.right;
+	treeNode_t& nodeB = m_nodes[indexB];
+	treeNode_t& nodeC = m_nodes[indexC];
+
+	const int balance = nodeC.height - nodeB.height;
+
+	// Rotate C up
+	if (balance > 1) {
+		const int indexF = nodeC.left;
+		const int indexG = nodeC.right;
+		treeNode_t& nodeF = m_nodes[indexF];
+		treeNode_t& nodeG = m_nodes[indexG];
+
+		// Swap A and C
+		nodeC.left = indexA;
+		nodeC.parent = nodeA.parent;
+		nodeA.parent = indexC;
+
+		// A's old parent should point to C
+		if (-1 != nodeC.parent) {
+			if (m_nodes[nodeC.parent].left == indexA)
+				m_nodes[nodeC.parent].left = indexC;
+			else
+				m_nodes[nodeC.parent].right = indexC;
+		}
+		else
+			m_root = indexC;
+
+		// Keep the taller grand child under C
+		if (nodeF.height > nodeG.height) {
+			nodeC.right = indexF;
+			nodeA.right = indexG;
+			nodeG.parent = indexA;
+			nodeA.bounds = GetUnion(nodeB.bounds, nodeG.bounds);
+			nodeC.bounds = GetUnion(nodeA.bounds, nodeF.bounds);
+
+			nodeA.height = 1 + std::max(nodeB.height, nodeG.height);
+			nodeC.height = 1 + std::max(nodeA.height, nodeF.height);
+		}
+		else {
+			nodeC.right = indexG;
+			nodeA.right = indexF;
+			nodeF.parent = indexA;
+			nodeA.bounds = GetUnion(nodeB.bounds, nodeF.bounds);
+			nodeC.bounds = GetUnion(nodeA.bounds, nodeG.bounds);
+
+			nodeA.height = 1 + std::max(nodeB.height, nodeF.height);
+			nodeC.height = 1 + std::max(nodeA.height, nodeG.height);
+		}
+		return indexC;
+	}
+
+	// Rotate B up
+	if (balance < -1) {
+		const int indexD = nodeB.left;
+		const int indexE = nodeB.right;
+		treeNode_t& nodeD = m_nodes[indexD];
+		treeNode_t& nodeE = m_nodes[indexE];
+
+		// Swap A and B
+		nodeB.left = indexA;
+		nodeB.parent = nodeA.parent;
+		nodeA.parent = indexB;
+
+		// A's old parent should point to B
+		if (-1 != nodeB.parent) {
+			if (m_nodes[nodeB.parent].left == indexA)
+				m_nodes[nodeB.parent].left = indexB;
+			else
+				m_nodes[nodeB.parent].right = indexB;
+		}
+		else
+			m_root = indexB;
+
+		// Keep the taller grand child under B
+		if (nodeD.height > nodeE.height) {
+			nodeB.right = indexD;
+			nodeA.left = indexE;
+			nodeE.parent = indexA;
+			nodeA.bounds = GetUnion(nodeC.bounds, nodeE.bounds);
+			nodeB.bounds = GetUnion(nodeA.bounds, nodeD.bounds);
+
+			nodeA.height = 1 + std::max(nodeC.height, nodeE.height);
+			nodeB.height = 1 + std::max(nodeA.height, nodeD.height);
+		}
+		else {
+			nodeB.right = indexE;
+			nodeA.left = indexD;
+			nodeD.parent = indexA;
+			nodeA.bounds = GetUnion(nodeC.bounds, nodeD.bounds);
+			nodeB.bounds = GetUnion(nodeA.bounds, nodeE.bounds);
+
+			nodeA.height = 1 + std::max(nodeC.height, nodeD.height);
+			nodeB.height = 1 + std::max(nodeA.height, nodeE.height);
+		}
+		return indexB;
+	}
+
+	return indexA;
+}
+
+/*
+====================================================
+DynamicTree::Query
+
+Appends the ids of the bodies whose fat bounds overlap the given bounds.
+====================================================
+*/
+void DynamicTree::Query(const Bounds& bounds, std::vector<int>& bodyIds) {
+	if (-1 == m_root)
+		return;
+
+	m_stack.clear();
+	m_stack.push_back(m_root);
+	while (!m_stack.empty()) {
+		const int nodeId = m_stack.back();
+		m_stack.pop_back();
+
+		const treeNode_t& node = m_nodes[nodeId];
+		if (!node.bounds.DoesIntersect(bounds))
+			continue;
+
+		if (node.IsLeaf())
+			bodyIds.push_back(node.bodyId);
+		else {
+			m_stack.push_back(node.left);
+			m_stack.push_back(node.right);
+		}
+	}
+}
@@ -0,0 +1,60 @@
+//
+//	DynamicTree.h
+//
+#pragma once
+
+struct treeNode_t {
+	Bounds bounds;	// fat bounds for leaves, union of the children otherwise
+
+	int parent;		// the next free node while the node is in the free list
+	int left;
+	int right;
+	int height;		// 0 for leaves, -1 for free nodes
+
+	int bodyId;
+
+	bool IsLeaf() const { return ( -1 == left ); }
+};
+
+/*
+====================================================
+DynamicTree
+
+Bounding volume tree with fat (inflated) leaf bounds.
+A leaf is only reinserted when its body leaves the fat bounds,
+and every insert/remove refits and rebalances the ancestors with rotations.
+====================================================
+*/
+class DynamicTree {
+public:
+	DynamicTree();
+
+	int CreateProxy( const Bounds & bounds, const int bodyId );
+	void DestroyProxy( const int proxyId );
+	bool MoveProxy( const int proxyId, const Bounds & bounds );
+
+	const Bounds & GetFatBounds( const int proxyId ) const { return m_nodes[ proxyId ].bounds; }
+	int GetBodyId( const int proxyId ) const { return m_nodes[ proxyId ].bodyId; }
+
+	void Query( const Bounds & bounds, std::vector< int > & bodyIds );
+	void Clear();
+
+	int GetHeight() const { return ( -1 == m_root ) ? 0 : m_nodes[ m_root ].height; }
+
+	static const float FAT_MARGIN;
+
+private:
+	int AllocateNode();
+	void FreeNode( const int nodeId );
+
+	void InsertLeaf( const int leafId );
+	void RemoveLeaf( const int leafId );
+	void Refit( int nodeId );
+	int Balance( const int nodeId );
+
+	std::vector< treeNode_t > m_nodes;
+	int m_root;
+	int m_freeList;
+
+	std::vector< int > m_stack;	// reused by Query to avoid allocations
+};
@@ -3,9 +3,10 @@
 //
 #include "PCH.h"
 #include "GJK.h"
+#include "../Math/SIMD.h"
 
 struct point_t;
-float Expand_EPA(const Body* bodyA, const Body* bodyB, const float bias, const point_t simplexPoints[4], Vec3& ptOnA, Vec3& ptOnB);
+float Expand_EPA(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, const float bias, const point_t simplexPoints[4], Vec3& ptOnA, Vec3& ptOnB, gjkCache_t* cache);
 
 /*
 ================================================================================================
@@ -245,26 +246,57 @@ struct point_t {
 /*
 ================================
 GetSupportPoint
+
+With a cache the shapes start searching from the support points of the last call on the pair.
 ================================
 */
-point_t GetSupportPoint(const Body* bodyA, const Body* bodyB, Vec3 dir, const float bias) {
+point_t GetSupportPoint(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, Vec3 dir, const float bias, gjkCache_t* cache) {
 	dir.Normalize();
 
+	int unusedVertexA = -1;
+	int unusedVertexB = -1;
+	int& supportVertexA = (nullptr != cache) ? cache->supportVertexA : unusedVertexA;
+	int& supportVertexB = (nullptr != cache) ? cache->supportVertexB : unusedVertexB;
+
 	point_t point;
 
 	// Find the point in A furthest in direction
-	point.ptA = bodyA->m_shape->GetSupportPoint(dir, bodyA->m_position, bodyA->m_orientation, bias);
+	point.ptA = bodyA->shape->GetSupportPointFrom(dir, bodyA->position, bodyA->orientation, bias, supportVertexA);
 
 	dir *= -1.0f;
 
 	// Find the point in B furthest in the opposite direction
-	point.ptB = bodyB->m_shape->GetSupportPoint(dir, bodyB->m_position, bodyB->m_orientation, bias);
+	point.ptB = bodyB->shape->GetSupportPointFrom(dir, bodyB->position, bodyB->orientation, bias, supportVertexB);
 
 	// Return the point, in the minkowski sum, furthest in the direction
 	point.xyz = point.ptA - point.ptB;
 	return point;
 }
 
+/*
+================================
+GetCoreSupportPoint
+
+GetSupportPoint on the cores of the shapes, the bias is left out since the margins already make up for the core.
+================================
+*/
+point_t GetCoreSupportPoint(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, Vec3 dir, const float bias, gjkCache_t* cache) {
+	dir.Normalize();
+
+	int unusedVertexA = -1;
+	int unusedVertexB = -1;
+	int& supportVertexA = (nullptr != cache) ? cache->supportVertexA : unusedVertexA;
+	int& supportVertexB = (nullptr != cache) ? cache->supportVertexB : unusedVertexB;
+
+	point_t point;
+	point.ptA = bodyA->shape->GetCoreSupportPointFrom(dir, bodyA->position, bodyA->orientation, supportVertexA);
+	point.ptB = bodyB->shape->GetCoreSupportPointFrom(dir * -1.0f, bodyB->position, bodyB->orientation, supportVertexB);
+	point.xyz = point.ptA - point.ptB;
+	return point;
+}
+
+typedef point_t (*supportFunction_t)(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, Vec3 dir, const float bias, gjkCache_t* cache);
+
 /*
 ================================
 SimplexSignedVolumes
@@ -387,127 +419,130 @@ static int GetNumberOfValidPoints(const Vec4& lambdas) {
 
 /*
 ================================
-DoesIntersect_GJK
+GetInitialDirection
+
+The direction the last query on the pair ended with, or a fixed one without it.
 ================================
 */
-bool DoesIntersect_GJK(const Body* bodyA, const Body* bodyB) {
-	const Vec3 ORIGIN(0.0f);
-
-	int numberOfTotalPoints = 1;
-	point_t simplexPoints[4];
-	simplexPoints[0] = GetSupportPoint(bodyA, bodyB, Vec3(1, 1, 1), 0.0f);
-
-	float currentClosestDistance = 1e10f;
-	bool doesContainOrigin = false;
-	Vec3 newDir = simplexPoints[0].xyz * -1.0f;
-	do {
-		// Get the new point to check on
-		point_t newPoint = GetSupportPoint(bodyA, bodyB, newDir, 0.0f);
-
-		// If the new point is the same as a previous point, then we can't expand any further
-		if (IsAlreadyAdded(simplexPoints, newPoint)) {
-			break;
-		}
-
-		simplexPoints[numberOfTotalPoints] = newPoint;
-		++numberOfTotalPoints;
-
-		// If this new point hasn't moved passed the origin, then the
-		// origin cannot be in the set. And therefore there is no collision.
-		float dotResult = newDir.Dot(newPoint.xyz - ORIGIN);
-		if (dotResult < 0.0f)
-			break;
-
-		Vec4 lambdas;
-		doesContainOrigin = GetBarycentricCoordinatesToOrigin(simplexPoints, numberOfTotalPoints, newDir, lambdas);
-		if (doesContainOrigin)
-			break;
-
-		// Check that the new projection of the origin onto the simplex is closer than the previous
-		float currentDistance = newDir.GetLengthSqr();
-		if (currentDistance >= currentClosestDistance)
-			break;
-		currentClosestDistance = currentDistance;
+static Vec3 GetInitialDirection(const gjkCache_t* cache) {
+	if (nullptr != cache && cache->isValid)
+		return cache->direction;
+	return Vec3(1, 1, 1);
+}
 
-		// Use the lambdas that support the new search direction, and invalidate any points that don't support it
-		SortValidSupportPoints(simplexPoints, lambdas);
-		numberOfTotalPoints = GetNumberOfValidPoints(lambdas);
-		doesContainOrigin = (4 == numberOfTotalPoints);
-	} while (!doesContainOrigin);
+/*
+================================
+UpdateCache
+================================
+*/
+static void UpdateCache(gjkCache_t* cache, const Vec3& lastDir) {
+	// the direction is lost when the simplex ends up on the origin, keep the older one then
+	if (nullptr == cache || lastDir.GetLengthSqr() < 1e-12f)
+		return;
 
-	return doesContainOrigin;
+	cache->direction = lastDir;
+	cache->isValid = true;
 }
 
 /*
 ================================
-DoesIntersect_GJK
+simplex_t
 ================================
 */
-bool DoesIntersect_GJK(const Body* bodyA, const Body* bodyB, const float bias, Vec3& contactPointOnA, Vec3& contactPointOnB) {
-	const Vec3 ORIGIN(0.0f);
+struct simplex_t {
+	point_t points[4];
+	Vec4 lambdas;	// barycentric coordinates of the point closest to the origin
+	int numPoints;
+};
 
-	int numberOfTotalPoints = 1;
-	point_t simplexPoints[4];
-	simplexPoints[0] = GetSupportPoint(bodyA, bodyB, Vec3(1, 1, 1), 0.0f);
+/*
+================================
+RunGJK
+
+The one GJK loop behind every query.
+Returns true when the simplex encloses the origin, otherwise the lambdas of the simplex give the closest points.
+Without needsClosestPoints it stops as soon as a support point shows the origin is outside,
+the simplex is then not the closest one.
+================================
+*/
+template <supportFunction_t getSupportPoint = GetSupportPoint>
+static bool RunGJK(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, const bool needsClosestPoints, gjkCache_t* cache, simplex_t& simplex) {
+	simplex.numPoints = 1;
+	simplex.points[0] = getSupportPoint(bodyA, bodyB, GetInitialDirection(cache), 0.0f, cache);
+	simplex.lambdas = Vec4(1, 0, 0, 0);
 
 	float currentClosestDistance = 1e10f;
 	bool doesContainOrigin = false;
-	Vec3 newDir = simplexPoints[0].xyz * -1.0f;
-
-	// 
-	// TODO: temporary fix (remove this logic after applying optimization)
-	//unsigned currentIterationCount = 0;
-	//const unsigned MAX_ITERATION_COUNT = 9;
+	Vec3 newDir = simplex.points[0].xyz * -1.0f;
 	do {
-		//if (currentIterationCount > MAX_ITERATION_COUNT)
-		//	break;
-
 		// Get the new point to check on
-		point_t newPoint = GetSupportPoint(bodyA, bodyB, newDir, 0.0f);
+		point_t newPoint = getSupportPoint(bodyA, bodyB, newDir, 0.0f, cache);
 
 		// If the new point is the same as a previous point, then we can't expand any further
-		if (IsAlreadyAdded(simplexPoints, newPoint))
+		if (IsAlreadyAdded(simplex.points, newPoint))
 			break;
 
-		simplexPoints[numberOfTotalPoints] = newPoint;
-		++numberOfTotalPoints;
-
 		// If this new point hasn't moved passed the origin, then the
 		// origin cannot be in the set. And therefore there is no collision.
-		float dotResult = newDir.Dot(newPoint.xyz - ORIGIN);
-		if (dotResult < 0.0f)
+		if (!needsClosestPoints && newDir.Dot(newPoint.xyz) < 0.0f)
 			break;
 
+		simplex.points[simplex.numPoints] = newPoint;
+		++simplex.numPoints;
+
 		Vec4 lambdas;
-		doesContainOrigin = GetBarycentricCoordinatesToOrigin(simplexPoints, numberOfTotalPoints, newDir, lambdas);
+		doesContainOrigin = GetBarycentricCoordinatesToOrigin(simplex.points, simplex.numPoints, newDir, lambdas);
 		if (doesContainOrigin)
 			break;
 
+		// Use the lambdas that support the new search direction, and invalidate any points that don't support it
+		SortValidSupportPoints(simplex.points, lambdas);
+		simplex.numPoints = GetNumberOfValidPoints(lambdas);
+		simplex.lambdas = lambdas;
+		doesContainOrigin = (4 == simplex.numPoints);
+
 		// Check that the new projection of the origin onto the simplex is closer than the previous
 		float currentDistance = newDir.GetLengthSqr();
 		if (currentDistance >= currentClosestDistance)
 			break;
 		currentClosestDistance = currentDistance;
-
-		// Use the lambdas that support the new search direction, and invalidate any points that don't support it
-		SortValidSupportPoints(simplexPoints, lambdas);
-		numberOfTotalPoints = GetNumberOfValidPoints(lambdas);
-		doesContainOrigin = (4 == numberOfTotalPoints);
-
-		//++currentIterationCount;
 	} while (!doesContainOrigin);
 
-	// Exit if there's no collision
-	if (!doesContainOrigin) {
-		return false;
+	UpdateCache(cache, newDir);
+	return doesContainOrigin;
+}
+
+/*
+================================
+GetClosestPoints
+================================
+*/
+static void GetClosestPoints(const simplex_t& simplex, Vec3& pointOnA, Vec3& pointOnB) {
+	pointOnA.Zero();
+	pointOnB.Zero();
+	for (int currentPoint = 0; currentPoint < 4; ++currentPoint) {
+		pointOnA += simplex.points[currentPoint].ptA * simplex.lambdas[currentPoint];
+		pointOnB += simplex.points[currentPoint].ptB * simplex.lambdas[currentPoint];
 	}
+}
+
+/*
+================================
+GetPenetration_EPA
+
+Grows the simplex that encloses the origin into a tetrahedron and expands it with EPA.
+================================
+*/
+static void GetPenetration_EPA(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, const float bias, simplex_t& simplex, Vec3& contactPointOnA, Vec3& contactPointOnB, gjkCache_t* cache) {
+	point_t* simplexPoints = simplex.points;
+	int numberOfTotalPoints = simplex.numPoints;
 
 	//
 	//	Check that we have a 3-simplex (EPA expects a tetrahedron)
 	//
 	if (1 == numberOfTotalPoints) {
 		Vec3 searchDir = simplexPoints[0].xyz * -1.0f;
-		point_t newPoint = GetSupportPoint(bodyA, bodyB, searchDir, 0.0f);
+		point_t newPoint = GetSupportPoint(bodyA, bodyB, searchDir, 0.0f, cache);
 		simplexPoints[numberOfTotalPoints] = newPoint;
 		++numberOfTotalPoints;
 	}
@@ -517,7 +552,7 @@ bool DoesIntersect_GJK(const Body* bodyA, const Body* bodyB, const float bias, V
 		ab.GetOrtho(u, v);
 
 		Vec3 newDir = u;
-		point_t newPoint = GetSupportPoint(bodyA, bodyB, newDir, 0.0f);
+		point_t newPoint = GetSupportPoint(bodyA, bodyB, newDir, 0.0f, cache);
 		simplexPoints[numberOfTotalPoints] = newPoint;
 		++numberOfTotalPoints;
 	}
@@ -527,7 +562,7 @@ bool DoesIntersect_GJK(const Body* bodyA, const Body* bodyB, const float bias, V
 		Vec3 norm = ab.Cross(ac);
 
 		Vec3 newDir = norm;
-		point_t newPoint = GetSupportPoint(bodyA, bodyB, newDir, 0.0f);
+		point_t newPoint = GetSupportPoint(bodyA, bodyB, newDir, 0.0f, cache);
 		simplexPoints[numberOfTotalPoints] = newPoint;
 		++numberOfTotalPoints;
 	}
@@ -556,7 +591,30 @@ bool DoesIntersect_GJK(const Body* bodyA, const Body* bodyB, const float bias, V
 	//
 	// Perform EPA expansion of the simplex to find the closest face on the CSO
 	//
-	Expand_EPA(bodyA, bodyB, bias, simplexPoints, contactPointOnA, contactPointOnB);
+	Expand_EPA(bodyA, bodyB, bias, simplexPoints, contactPointOnA, contactPointOnB, cache);
+}
+
+/*
+================================
+DoesIntersect_GJK
+================================
+*/
+bool DoesIntersect_GJK(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache) {
+	simplex_t simplex;
+	return RunGJK(bodyA, bodyB, false, cache, simplex);
+}
+
+/*
+================================
+DoesIntersect_GJK
+================================
+*/
+bool DoesIntersect_GJK(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, const float bias, Vec3& contactPointOnA, Vec3& contactPointOnB, gjkCache_t* cache) {
+	simplex_t simplex;
+	if (!RunGJK(bodyA, bodyB, false, cache, simplex))
+		return false;
+
+	GetPenetration_EPA(bodyA, bodyB, bias, simplex, contactPointOnA, contactPointOnB, cache);
 	return true;
 }
 
@@ -565,47 +623,516 @@ bool DoesIntersect_GJK(const Body* bodyA, const Body* bodyB, const float bias, V
 FindClosestPoints_GJK
 ================================
 */
-void FindClosestPoints_GJK(const Body* bodyA, const Body* bodyB, Vec3& pointOnA, Vec3& pointOnB) {
-	float currentClosestDistance = 1e10f;
-	const float bias = 0.0f;
+void FindClosestPoints_GJK(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, Vec3& pointOnA, Vec3& pointOnB, gjkCache_t* cache) {
+	simplex_t simplex;
+	RunGJK(bodyA, bodyB, true, cache, simplex);
+	GetClosestPoints(simplex, pointOnA, pointOnB);
+}
 
-	int numberOfTotalPoints = 1;
-	point_t simplexPoints[4];
-	simplexPoints[0] = GetSupportPoint(bodyA, bodyB, Vec3(1, 1, 1), bias);
+/*
+================================
+FindCoreClosestPoints_GJK
+================================
+*/
+bool FindCoreClosestPoints_GJK(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, Vec3& pointOnA, Vec3& pointOnB, gjkCache_t* cache) {
+	simplex_t simplex;
+	if (RunGJK<GetCoreSupportPoint>(bodyA, bodyB, true, cache, simplex))
+		return false;
 
-	Vec4 lambdas = Vec4(1, 0, 0, 0);
-	Vec3 newDir = simplexPoints[0].xyz * -1.0f;
-	do {
-		// Get the new point to check on
-		point_t newPoint = GetSupportPoint(bodyA, bodyB, newDir, bias);
+	GetClosestPoints(simplex, pointOnA, pointOnB);
+	return true;
+}
 
-		// If the new point is the same as a previous point, then we can't expand any further
-		if (IsAlreadyAdded(simplexPoints, newPoint))
-			break;
+/*
+================================
+FindContactPoints_GJK
 
-		// Add point and get new search direction
-		simplexPoints[numberOfTotalPoints] = newPoint;
-		++numberOfTotalPoints;
+One GJK run for both answers, the closest points while apart and the EPA points once overlapping.
+================================
+*/
+bool FindContactPoints_GJK(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, const float bias, Vec3& pointOnA, Vec3& pointOnB, gjkCache_t* cache) {
+	simplex_t simplex;
+	if (RunGJK(bodyA, bodyB, true, cache, simplex)) {
+		GetPenetration_EPA(bodyA, bodyB, bias, simplex, pointOnA, pointOnB, cache);
+		return true;
+	}
 
-		GetBarycentricCoordinatesToOrigin(simplexPoints, numberOfTotalPoints, newDir, lambdas);
-		SortValidSupportPoints(simplexPoints, lambdas);
-		numberOfTotalPoints = GetNumberOfValidPoints(lambdas);
+	GetClosestPoints(simplex, pointOnA, pointOnB);
+	return false;
+}
 
-		// Check that the new projection of the origin onto the simplex is closer than the previous
-		float currentDistance = newDir.GetLengthSqr();
-		if (currentDistance >= currentClosestDistance)
-			break;
-		currentClosestDistance = currentDistance;
-	} while (numberOfTotalPoints < 4);
 
-	pointOnA.Zero();
-	pointOnB.Zero();
-	for (int currentPoint = 0; currentPoint < 4; ++currentPoint) {
-		pointOnA += simplexPoints[currentPoint].ptA * lambdas[currentPoint];
-		pointOnB += simplexPoints[currentPoint].ptB * lambdas[currentPoint];
+/*
+================================================================================================
+
+Batched GJK
+
+================================================================================================
+*/
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+// pairs AreSeparated_GJKBatch runs side by side, one per SSE lane
+static const int GJK_BATCH_LANES = 4;
+
+/*
+================================
+vec3Lanes_t
+
+One Vec3 per lane, and the vector math the batch needs on them
+================================
+*/
+struct vec3Lanes_t {
+	__m128 x;
+	__m128 y;
+	__m128 z;
+};
+
+static inline vec3Lanes_t Add_Lanes(const vec3Lanes_t& a, const vec3Lanes_t& b) {
+	return { _mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z) };
+}
+
+static inline vec3Lanes_t Sub_Lanes(const vec3Lanes_t& a, const vec3Lanes_t& b) {
+	return { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+}
+
+static inline vec3Lanes_t Scale_Lanes(const vec3Lanes_t& a, const __m128 scale) {
+	return { _mm_mul_ps(a.x, scale), _mm_mul_ps(a.y, scale), _mm_mul_ps(a.z, scale) };
+}
+
+static inline __m128 Dot_Lanes(const vec3Lanes_t& a, const vec3Lanes_t& b) {
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline vec3Lanes_t Cross_Lanes(const vec3Lanes_t& a, const vec3Lanes_t& b) {
+	return {
+		_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+		_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+		_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))
+	};
+}
+
+// a where the mask is set, b elsewhere
+static inline __m128 Select_Lanes(const __m128 mask, const __m128 a, const __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline vec3Lanes_t Select_Lanes(const __m128 mask, const vec3Lanes_t& a, const vec3Lanes_t& b) {
+	return { Select_Lanes(mask, a.x, b.x), Select_Lanes(mask, a.y, b.y), Select_Lanes(mask, a.z, b.z) };
+}
+
+static inline vec3Lanes_t Load_Lanes(const float values[3][GJK_BATCH_LANES]) {
+	return { _mm_loadu_ps(values[0]), _mm_loadu_ps(values[1]), _mm_loadu_ps(values[2]) };
+}
+
+// row i and column k of a 3x3 matrix per lane
+static inline vec3Lanes_t LoadRow_Lanes(const float matrix[3][3][GJK_BATCH_LANES], const int i) {
+	return { _mm_loadu_ps(matrix[i][0]), _mm_loadu_ps(matrix[i][1]), _mm_loadu_ps(matrix[i][2]) };
+}
+
+static inline vec3Lanes_t LoadColumn_Lanes(const float matrix[3][3][GJK_BATCH_LANES], const int k) {
+	return { _mm_loadu_ps(matrix[0][k]), _mm_loadu_ps(matrix[1][k]), _mm_loadu_ps(matrix[2][k]) };
+}
+
+static inline void Store_Lanes(float values[3][GJK_BATCH_LANES], const vec3Lanes_t& a) {
+	_mm_storeu_ps(values[0], a.x);
+	_mm_storeu_ps(values[1], a.y);
+	_mm_storeu_ps(values[2], a.z);
+}
+
+// hulls with more points climb their support hierarchy instead of scanning every point
+static const int GJK_BATCH_MAX_SCANNED_POINTS = 256;
+
+/*
+================================
+FindSupportVertex_SoA
+
+The support vertex of a hull, scanned four points at a time over ShapeConvex::m_pointCoordinates.
+Of equally far points the first one wins, so the padding never does.
+================================
+*/
+static int FindSupportVertex_SoA(const ShapeConvex* hull, const Vec3& localDir) {
+	const float* xs = hull->m_pointCoordinates[0].data();
+	const float* ys = hull->m_pointCoordinates[1].data();
+	const float* zs = hull->m_pointCoordinates[2].data();
+	const int numCoordinates = static_cast<int>(hull->m_pointCoordinates[0].size());
+
+	const __m128 dirX = _mm_set1_ps(localDir.x);
+	const __m128 dirY = _mm_set1_ps(localDir.y);
+	const __m128 dirZ = _mm_set1_ps(localDir.z);
+	__m128 bestDot = _mm_set1_ps(-FLT_MAX);
+	__m128i bestVertex = _mm_setzero_si128();
+	__m128i vertex = _mm_setr_epi32(0, 1, 2, 3);
+	for (int pointIndex = 0; pointIndex < numCoordinates; pointIndex += 4) {
+		const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(xs + pointIndex), dirX), _mm_mul_ps(_mm_loadu_ps(ys + pointIndex), dirY)), _mm_mul_ps(_mm_loadu_ps(zs + pointIndex), dirZ));
+		const __m128i isBetter = _mm_castps_si128(_mm_cmpgt_ps(dot, bestDot));
+		bestDot = _mm_max_ps(dot, bestDot);
+		bestVertex = _mm_or_si128(_mm_and_si128(isBetter, vertex), _mm_andnot_si128(isBetter, bestVertex));
+		vertex = _mm_add_epi32(vertex, _mm_set1_epi32(4));
 	}
+
+	float dots[4];
+	int vertices[4];
+	_mm_storeu_ps(dots, bestDot);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(vertices), bestVertex);
+	int best = 0;
+	for (int slot = 1; slot < 4; ++slot) {
+		if (dots[slot] > dots[best] || (dots[slot] == dots[best] && vertices[slot] < vertices[best]))
+			best = slot;
+	}
+	return vertices[best];
 }
 
+/*
+================================
+hullLanes_t
+
+The hull on one side of every lane and the support vertex the lane is at
+================================
+*/
+struct hullLanes_t {
+	const ShapeConvex* hulls[GJK_BATCH_LANES];
+	const float* coordinates[3][GJK_BATCH_LANES];
+	int vertices[GJK_BATCH_LANES];
+
+	void Set(const int lane, const ShapeConvex* hull, const int startVertex) {
+		hulls[lane] = hull;
+		for (int axis = 0; axis < 3; ++axis)
+			coordinates[axis][lane] = hull->m_pointCoordinates[axis].data();
+		const bool isVertex = startVertex >= 0 && startVertex < static_cast<int>(hull->m_points.size());
+		vertices[lane] = isVertex ? startVertex : 0;
+	}
+
+	// the support vertex of every active lane in its body space direction
+	void FindSupportVertices(const vec3Lanes_t& localDirs, const int activeLanes) {
+		float dirX[GJK_BATCH_LANES];
+		float dirY[GJK_BATCH_LANES];
+		float dirZ[GJK_BATCH_LANES];
+		_mm_storeu_ps(dirX, localDirs.x);
+		_mm_storeu_ps(dirY, localDirs.y);
+		_mm_storeu_ps(dirZ, localDirs.z);
+		for (int lane = 0; lane < GJK_BATCH_LANES; ++lane) {
+			if (0 == (activeLanes & (1 << lane)))
+				continue;
+
+			const Vec3 localDir(dirX[lane], dirY[lane], dirZ[lane]);
+			if (static_cast<int>(hulls[lane]->m_points.size()) <= GJK_BATCH_MAX_SCANNED_POINTS)
+				vertices[lane] = FindSupportVertex_SoA(hulls[lane], localDir);
+			else
+				vertices[lane] = hulls[lane]->GetSupportVertex(localDir, vertices[lane]);
+		}
+	}
+
+	vec3Lanes_t GetPoints() const {
+		vec3Lanes_t points;
+		points.x = _mm_setr_ps(coordinates[0][0][vertices[0]], coordinates[0][1][vertices[1]], coordinates[0][2][vertices[2]], coordinates[0][3][vertices[3]]);
+		points.y = _mm_setr_ps(coordinates[1][0][vertices[0]], coordinates[1][1][vertices[1]], coordinates[1][2][vertices[2]], coordinates[1][3][vertices[3]]);
+		points.z = _mm_setr_ps(coordinates[2][0][vertices[0]], coordinates[2][1][vertices[1]], coordinates[2][2][vertices[2]], coordinates[2][3][vertices[3]]);
+		return points;
+	}
+};
+
+/*
+================================
+closestLanes_t
+
+The closest point found so far on the simplex of every lane, and the feature it lies on
+as the new point plus two more (repeated when the feature has fewer)
+================================
+*/
+struct closestLanes_t {
+	vec3Lanes_t point;
+	__m128 distanceSqr;
+	vec3Lanes_t featureB;
+	vec3Lanes_t featureC;
+
+	void Keep(const __m128 isInside, const vec3Lanes_t& candidate, const vec3Lanes_t& b, const vec3Lanes_t& c) {
+		const __m128 candidateDistanceSqr = Dot_Lanes(candidate, candidate);
+		const __m128 isCloser = _mm_and_ps(isInside, _mm_cmplt_ps(candidateDistanceSqr, distanceSqr));
+		point = Select_Lanes(isCloser, candidate, point);
+		distanceSqr = Select_Lanes(isCloser, candidateDistanceSqr, distanceSqr);
+		featureB = Select_Lanes(isCloser, b, featureB);
+		featureC = Select_Lanes(isCloser, c, featureC);
+	}
+};
+
+// edges and triangles this short or this flat are left to the features around them
+static const float GJK_BATCH_EDGE_EPSILON = 1e-12f;
+static const float GJK_BATCH_TRIANGLE_EPSILON = 1e-5f;
+
+/*
+================================
+KeepEdge_Lanes
+================================
+*/
+static void KeepEdge_Lanes(const vec3Lanes_t& a, const vec3Lanes_t& b, closestLanes_t& closest) {
+	const __m128 epsilon = _mm_set1_ps(GJK_BATCH_EDGE_EPSILON);
+	const vec3Lanes_t ab = Sub_Lanes(b, a);
+	const __m128 lengthSqr = Dot_Lanes(ab, ab);
+	const __m128 t = _mm_div_ps(_mm_sub_ps(_mm_setzero_ps(), Dot_Lanes(a, ab)), _mm_max_ps(lengthSqr, epsilon));
+
+	__m128 isInside = _mm_cmpgt_ps(lengthSqr, epsilon);
+	isInside = _mm_and_ps(isInside, _mm_cmpgt_ps(t, _mm_setzero_ps()));
+	isInside = _mm_and_ps(isInside, _mm_cmplt_ps(t, _mm_set1_ps(1.0f)));
+	closest.Keep(isInside, Add_Lanes(a, Scale_Lanes(ab, t)), b, b);
+}
+
+/*
+================================
+KeepTriangle_Lanes
+================================
+*/
+static void KeepTriangle_Lanes(const vec3Lanes_t& a, const vec3Lanes_t& b, const vec3Lanes_t& c, closestLanes_t& closest) {
+	const vec3Lanes_t ab = Sub_Lanes(b, a);
+	const vec3Lanes_t ac = Sub_Lanes(c, a);
+	const __m128 d00 = Dot_Lanes(ab, ab);
+	const __m128 d01 = Dot_Lanes(ab, ac);
+	const __m128 d11 = Dot_Lanes(ac, ac);
+	const __m128 d20 = _mm_sub_ps(_mm_setzero_ps(), Dot_Lanes(a, ab));
+	const __m128 d21 = _mm_sub_ps(_mm_setzero_ps(), Dot_Lanes(a, ac));
+	const __m128 lengthsSqr = _mm_mul_ps(d00, d11);
+	const __m128 denominator = _mm_sub_ps(lengthsSqr, _mm_mul_ps(d01, d01));
+	const __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(denominator, _mm_set1_ps(FLT_MIN)));
+
+	// the weights of b and c of the origin projected onto the plane
+	const __m128 u = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(d11, d20), _mm_mul_ps(d01, d21)), inverse);
+	const __m128 v = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(d00, d21), _mm_mul_ps(d01, d20)), inverse);
+
+	__m128 isInside = _mm_cmpgt_ps(denominator, _mm_mul_ps(lengthsSqr, _mm_set1_ps(GJK_BATCH_TRIANGLE_EPSILON)));
+	isInside = _mm_and_ps(isInside, _mm_cmpgt_ps(u, _mm_setzero_ps()));
+	isInside = _mm_and_ps(isInside, _mm_cmpgt_ps(v, _mm_setzero_ps()));
+	isInside = _mm_and_ps(isInside, _mm_cmplt_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	closest.Keep(isInside, Add_Lanes(a, Add_Lanes(Scale_Lanes(ab, u), Scale_Lanes(ac, v))), b, c);
+}
+
+/*
+================================
+ContainsOrigin_Lanes
+
+The tetrahedron encloses the origin when the origin is on the inner side of all four faces,
+its signed volume with every face has the sign of the whole volume. Flat ones never do.
+================================
+*/
+static __m128 ContainsOrigin_Lanes(const vec3Lanes_t& a, const vec3Lanes_t& b, const vec3Lanes_t& c, const vec3Lanes_t& d) {
+	const vec3Lanes_t ab = Sub_Lanes(b, a);
+	const vec3Lanes_t ac = Sub_Lanes(c, a);
+	const vec3Lanes_t ad = Sub_Lanes(d, a);
+	const vec3Lanes_t ao = Sub_Lanes({ _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() }, a);
+
+	const __m128 volume = Dot_Lanes(ab, Cross_Lanes(ac, ad));
+	const __m128 volumeB = Dot_Lanes(ao, Cross_Lanes(ac, ad));
+	const __m128 volumeC = Dot_Lanes(ao, Cross_Lanes(ad, ab));
+	const __m128 volumeD = Dot_Lanes(ao, Cross_Lanes(ab, ac));
+	const __m128 volumeA = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(volume, volumeB), volumeC), volumeD);
+
+	const __m128 zero = _mm_setzero_ps();
+	__m128 isInside = _mm_cmpgt_ps(_mm_mul_ps(volume, volumeA), zero);
+	isInside = _mm_and_ps(isInside, _mm_cmpgt_ps(_mm_mul_ps(volume, volumeB), zero));
+	isInside = _mm_and_ps(isInside, _mm_cmpgt_ps(_mm_mul_ps(volume, volumeC), zero));
+	isInside = _mm_and_ps(isInside, _mm_cmpgt_ps(_mm_mul_ps(volume, volumeD), zero));
+	return isInside;
+}
+
+/*
+================================
+SolveSimplex_Lanes
+
+The point closest to the origin on the simplex of the new support point a and the last simplex b, c, d,
+which repeats its points when it has fewer than three. Like the signed volumes of RunGJK
+the closest feature always holds the new point, so the candidates are a, the three edges and the
+three triangles through it. Each one is computed in every lane and kept where the origin projects
+inside it and it is the closest so far.
+================================
+*/
+static void SolveSimplex_Lanes(const vec3Lanes_t& a, const vec3Lanes_t& b, const vec3Lanes_t& c, const vec3Lanes_t& d, closestLanes_t& closest) {
+	closest.point = a;
+	closest.distanceSqr = Dot_Lanes(a, a);
+	closest.featureB = a;
+	closest.featureC = a;
+
+	KeepEdge_Lanes(a, b, closest);
+	KeepEdge_Lanes(a, c, closest);
+	KeepEdge_Lanes(a, d, closest);
+
+	KeepTriangle_Lanes(a, b, c, closest);
+	KeepTriangle_Lanes(a, c, d, closest);
+	KeepTriangle_Lanes(a, d, b, closest);
+}
+
+/*
+================================
+AreSeparated_GJKBatch
+
+GJK on GJK_BATCH_LANES pairs side by side. Every lane works in the body space of its A,
+with B placed by its pose relative to A, so a support point costs one rotation of the direction.
+Each lane scans its own hulls for the support vertices (FindSupportVertex_SoA), a climb over the hull
+would keep the other lanes waiting on the longest one. The simplices come from SolveSimplex_Lanes,
+and every round ends with a mask of the lanes that are done:
+- the new support point shows the origin is further than minDistance from the difference of the hulls
+- the simplex gets within minDistance of the origin or encloses it
+- the simplex stops getting closer, or the lane ran out of rounds
+Only the first one proves the pair apart. It rests on the exact support point alone,
+so the loose simplex math can only cost rounds, never a wrong answer.
+A lane that is done takes the next pair right away. The search starts from the cached direction of the pair,
+for pairs that were apart last step the first support point usually settles it.
+================================
+*/
+void AreSeparated_GJKBatch(gjkBatchPair_t* pairs, const int count) {
+	const int MAX_ITERATIONS = 32;
+
+	// the new point gets the simplex no closer than this part of its distance
+	const float CONVERGED_EPSILON = 1e-6f;
+
+	if (count <= 0)
+		return;
+
+	hullLanes_t hullsA;
+	hullLanes_t hullsB;
+	float rotations[3][3][GJK_BATCH_LANES];	// [ i ][ k ] is axis i of A dotted with axis k of B
+	float translations[3][GJK_BATCH_LANES];	// the position of B in the body space of A
+	float directions[3][GJK_BATCH_LANES];	// where the next support point is searched
+	float simplices[3][3][GJK_BATCH_LANES] = {};	// [ point ][ axis ], the first one is the newest
+	float lastDistancesSqr[GJK_BATCH_LANES];
+	float minDistancesSqr[GJK_BATCH_LANES];
+	int numIterations[GJK_BATCH_LANES];
+	int pairIndices[GJK_BATCH_LANES];
+
+	auto loadPair = [&](const int lane, const int pairIndex) {
+		const gjkBatchPair_t& pair = pairs[pairIndex];
+		const Mat3 axesA = pair.bodyA->m_orientation.ToMat3();	// the rows are the axes of the body in world space
+		const Mat3 axesB = pair.bodyB->m_orientation.ToMat3();
+		const Vec3 offset = pair.bodyB->m_position - pair.bodyA->m_position;
+		const Vec3 worldDir = GetInitialDirection(pair.cache);
+
+		for (int i = 0; i < 3; ++i) {
+			for (int k = 0; k < 3; ++k)
+				rotations[i][k][lane] = axesA.rows[i].Dot(axesB.rows[k]);
+			translations[i][lane] = axesA.rows[i].Dot(offset);
+			directions[i][lane] = axesA.rows[i].Dot(worldDir);
+		}
+
+		const int startVertexA = (nullptr != pair.cache) ? pair.cache->supportVertexA : -1;
+		const int startVertexB = (nullptr != pair.cache) ? pair.cache->supportVertexB : -1;
+		hullsA.Set(lane, (const ShapeConvex*)pair.bodyA->m_shape, startVertexA);
+		hullsB.Set(lane, (const ShapeConvex*)pair.bodyB->m_shape, startVertexB);
+
+		lastDistancesSqr[lane] = FLT_MAX;
+		minDistancesSqr[lane] = pair.minDistance * pair.minDistance;
+		numIterations[lane] = 0;
+		pairIndices[lane] = pairIndex;
+	};
+
+	// lanes without a pair of their own run the first one again, their answers are dropped
+	int nextPair = 0;
+	int activeLanes = 0;
+	for (int lane = 0; lane < GJK_BATCH_LANES; ++lane) {
+		if (nextPair < count) {
+			pairs[nextPair].isSeparated = false;
+			loadPair(lane, nextPair++);
+			activeLanes |= 1 << lane;
+		}
+		else {
+			loadPair(lane, 0);
+		}
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	while (0 != activeLanes) {
+		const vec3Lanes_t dir = Load_Lanes(directions);
+
+		// B is searched the opposite way, in its own body space
+		const vec3Lanes_t dirB = {
+			_mm_sub_ps(zero, Dot_Lanes(LoadColumn_Lanes(rotations, 0), dir)),
+			_mm_sub_ps(zero, Dot_Lanes(LoadColumn_Lanes(rotations, 1), dir)),
+			_mm_sub_ps(zero, Dot_Lanes(LoadColumn_Lanes(rotations, 2), dir))
+		};
+
+		hullsA.FindSupportVertices(dir, activeLanes);
+		hullsB.FindSupportVertices(dirB, activeLanes);
+
+		// the new support point of the difference, A's point minus B's point placed in the body space of A
+		const vec3Lanes_t pointA = hullsA.GetPoints();
+		const vec3Lanes_t pointB = hullsB.GetPoints();
+		const vec3Lanes_t translation = Load_Lanes(translations);
+		const vec3Lanes_t pointBInA = {
+			Dot_Lanes(LoadRow_Lanes(rotations, 0), pointB),
+			Dot_Lanes(LoadRow_Lanes(rotations, 1), pointB),
+			Dot_Lanes(LoadRow_Lanes(rotations, 2), pointB)
+		};
+		const vec3Lanes_t w = Sub_Lanes(pointA, Add_Lanes(pointBInA, translation));
+
+		// the difference lies behind the plane through w across dir, so the origin is at least -dir.w / |dir| away from it
+		const __m128 dirDotW = Dot_Lanes(dir, w);
+		const __m128 dirLengthSqr = Dot_Lanes(dir, dir);
+		const __m128 minDistanceSqr = _mm_loadu_ps(minDistancesSqr);
+		const __m128 isSeparated = _mm_and_ps(_mm_cmplt_ps(dirDotW, zero), _mm_cmpgt_ps(_mm_mul_ps(dirDotW, dirDotW), _mm_mul_ps(minDistanceSqr, dirLengthSqr)));
+
+		// the first point of a lane starts its simplex, later ones add to the last one
+		const __m128i iterations = _mm_loadu_si128(reinterpret_cast<const __m128i*>(numIterations));
+		const __m128 isFirst = _mm_castsi128_ps(_mm_cmpeq_epi32(iterations, _mm_setzero_si128()));
+		const vec3Lanes_t b = Select_Lanes(isFirst, w, Load_Lanes(simplices[0]));
+		const vec3Lanes_t c = Select_Lanes(isFirst, w, Load_Lanes(simplices[1]));
+		const vec3Lanes_t d = Select_Lanes(isFirst, w, Load_Lanes(simplices[2]));
+
+		// with v = -dir the closest point so far, w gets the simplex no closer than |v|^2 - v.w
+		const __m128 isConverged = _mm_andnot_ps(isFirst, _mm_cmple_ps(_mm_add_ps(dirLengthSqr, dirDotW), _mm_mul_ps(dirLengthSqr, _mm_set1_ps(CONVERGED_EPSILON))));
+
+		closestLanes_t closest;
+		SolveSimplex_Lanes(w, b, c, d, closest);
+
+		const __m128i nextIterations = _mm_add_epi32(iterations, _mm_set1_epi32(1));
+		__m128 isDone = _mm_or_ps(isSeparated, isConverged);
+		isDone = _mm_or_ps(isDone, ContainsOrigin_Lanes(w, b, c, d));
+		isDone = _mm_or_ps(isDone, _mm_cmple_ps(closest.distanceSqr, minDistanceSqr));
+		isDone = _mm_or_ps(isDone, _mm_cmpnlt_ps(closest.distanceSqr, _mm_loadu_ps(lastDistancesSqr)));
+		isDone = _mm_or_ps(isDone, _mm_castsi128_ps(_mm_cmpgt_epi32(nextIterations, _mm_set1_epi32(MAX_ITERATIONS - 1))));
+
+		// lanes that are done keep the direction they ended with for the cache
+		Store_Lanes(simplices[0], w);
+		Store_Lanes(simplices[1], closest.featureB);
+		Store_Lanes(simplices[2], closest.featureC);
+		Store_Lanes(directions, Select_Lanes(isDone, dir, Sub_Lanes({ zero, zero, zero }, closest.point)));
+		_mm_storeu_ps(lastDistancesSqr, closest.distanceSqr);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(numIterations), nextIterations);
+
+		const int doneLanes = _mm_movemask_ps(isDone) & activeLanes;
+		const int separatedLanes = _mm_movemask_ps(isSeparated);
+		for (int lane = 0; lane < GJK_BATCH_LANES; ++lane) {
+			if (0 == (doneLanes & (1 << lane)))
+				continue;
+
+			gjkBatchPair_t& pair = pairs[pairIndices[lane]];
+			pair.isSeparated = (0 != (separatedLanes & (1 << lane)));
+			if (pair.isSeparated && nullptr != pair.cache) {
+				const Vec3 localDir(directions[0][lane], directions[1][lane], directions[2][lane]);
+				UpdateCache(pair.cache, pair.bodyA->m_orientation.RotatePoint(localDir));
+				pair.cache->supportVertexA = hullsA.vertices[lane];
+				pair.cache->supportVertexB = hullsB.vertices[lane];
+			}
+
+			if (nextPair < count) {
+				pairs[nextPair].isSeparated = false;
+				loadPair(lane, nextPair++);
+			}
+			else {
+				activeLanes &= ~(1 << lane);
+			}
+		}
+	}
+}
+#else
+/*
+================================
+AreSeparated_GJKBatch
+
+Without SSE there are no lanes, every pair is left to the full query
+================================
+*/
+void AreSeparated_GJKBatch(gjkBatchPair_t* pairs, const int count) {
+	for (int pairIndex = 0; pairIndex < count; ++pairIndex)
+		pairs[pairIndex].isSeparated = false;
+}
+#endif
+
 
 /*
 ================================================================================================
@@ -696,163 +1223,224 @@ Vec3 GetBarycentricCoordinates(Vec3 s1, Vec3 s2, Vec3 s3, const Vec3& targetPoin
 
 /*
 ================================
-GetNormalOfTriangle
+epaPolytope_t
+
+Everything EPA needs lives in fixed size arrays on the stack, nothing is allocated per query.
+Every face knows the face across each of its edges, edge i runs from vertex i to vertex i + 1,
+so the horizon is found by walking from the face that was expanded instead of comparing every edge with every other.
+The faces that may be expanded sit in a min heap on their distance to the origin,
+removed faces stay in the heap and are skipped when they come out.
 ================================
 */
-Vec3 GetNormalOfTriangle(const tri_t& targetTriangle, const std::vector< point_t >& points) {
-	const Vec3& a = points[targetTriangle.a].xyz;
-	const Vec3& b = points[targetTriangle.b].xyz;
-	const Vec3& c = points[targetTriangle.c].xyz;
+struct epaFace_t {
+	int vertices[3];
+	int adjacent[3];	// the face across edge i
+	int adjacentEdge[3];	// which edge of that face it is
+	Vec3 normal;
+	float distance;		// signed distance of the origin plane, positive while the origin is inside
+	bool isRemoved;
+};
 
-	Vec3 ab = b - a;
-	Vec3 ac = c - a;
-	Vec3 normal = ab.Cross(ac);
-	normal.Normalize();
-	return normal;
-}
+struct epaHeapEntry_t {
+	float distance;
+	int face;
+
+	bool operator < ( const epaHeapEntry_t & rhs ) const { return distance > rhs.distance; }	// std heaps put the largest first
+};
+
+struct epaHorizonEdge_t {
+	int face;
+	int edge;
+};
+
+struct epaPolytope_t {
+	static const int MAX_ITERATIONS = 64;
+	static const int MAX_POINTS = 4 + MAX_ITERATIONS;
+	static const int MAX_FACES = 256;
+
+	point_t points[MAX_POINTS];
+	epaFace_t faces[MAX_FACES];
+	epaHeapEntry_t heap[MAX_FACES];	// every face is pushed once
+	epaHorizonEdge_t horizon[MAX_POINTS];	// every horizon vertex is a different point
+
+	int numPoints;
+	int numFaces;
+	int numHeapEntries;
+	int numHorizonEdges;
+};
 
 /*
 ================================
-GetSignedDistanceFromPointToTriangle
+AddFace_EPA
+
+Returns the index of the new face, or -1 when the polytope is full.
 ================================
 */
-float GetSignedDistanceFromPointToTriangle(const tri_t& triangle, const Vec3& targetPoint, const std::vector< point_t >& points) {
-	const Vec3 normal = GetNormalOfTriangle(triangle, points);
-	const Vec3& vertexA = points[triangle.a].xyz;
-	const Vec3 aToPoint = targetPoint - vertexA;
-	const float distance = normal.Dot(aToPoint);
-	return distance;
+static int AddFace_EPA(epaPolytope_t& polytope, const int a, const int b, const int c) {
+	if (polytope.numFaces >= epaPolytope_t::MAX_FACES)
+		return -1;
+
+	const int faceIndex = polytope.numFaces++;
+	epaFace_t& face = polytope.faces[faceIndex];
+	face.vertices[0] = a;
+	face.vertices[1] = b;
+	face.vertices[2] = c;
+	for (int currentEdge = 0; currentEdge < 3; ++currentEdge) {
+		face.adjacent[currentEdge] = -1;
+		face.adjacentEdge[currentEdge] = -1;
+	}
+	face.isRemoved = false;
+
+	const Vec3& vertexA = polytope.points[a].xyz;
+	face.normal = (polytope.points[b].xyz - vertexA).Cross(polytope.points[c].xyz - vertexA);
+	face.normal.Normalize();
+	face.distance = face.normal.Dot(vertexA);
+
+	// A degenerate face has no usable normal, it still closes the polytope but is never expanded
+	if (face.normal.IsValid() && face.normal.GetLengthSqr() > 0.5f) {
+		epaHeapEntry_t& entry = polytope.heap[polytope.numHeapEntries++];
+		entry.distance = fabsf(face.distance);
+		entry.face = faceIndex;
+		std::push_heap(polytope.heap, polytope.heap + polytope.numHeapEntries);
+	}
+	return faceIndex;
 }
 
 /*
 ================================
-GetClosestTriangleToOrigin
+LinkFaces_EPA
 ================================
 */
-int GetClosestTriangleToOrigin(const std::vector< tri_t >& triangles, const std::vector< point_t >& points) {
-	float minDistanceSquared = 1e10;
+static void LinkFaces_EPA(epaPolytope_t& polytope, const int faceA, const int edgeA, const int faceB, const int edgeB) {
+	polytope.faces[faceA].adjacent[edgeA] = faceB;
+	polytope.faces[faceA].adjacentEdge[edgeA] = edgeB;
+	polytope.faces[faceB].adjacent[edgeB] = faceA;
+	polytope.faces[faceB].adjacentEdge[edgeB] = edgeA;
+}
 
-	int targetTriangleIndex = -1;
-	for (int currentTriangleIndex = 0; currentTriangleIndex < triangles.size(); ++currentTriangleIndex) {
-		const tri_t& currentTriangle = triangles[currentTriangleIndex];
+/*
+================================
+PopClosestFace_EPA
 
-		float currentDistance = GetSignedDistanceFromPointToTriangle(currentTriangle, Vec3(0.0f), points);
-		float currentDistanceSquared = currentDistance * currentDistance;
-		if (currentDistanceSquared < minDistanceSquared) {
-			targetTriangleIndex = currentTriangleIndex;
-			minDistanceSquared = currentDistanceSquared;
-		}
+Returns -1 when no face is left.
+================================
+*/
+static int PopClosestFace_EPA(epaPolytope_t& polytope) {
+	while (polytope.numHeapEntries > 0) {
+		std::pop_heap(polytope.heap, polytope.heap + polytope.numHeapEntries);
+		--polytope.numHeapEntries;
+
+		const int faceIndex = polytope.heap[polytope.numHeapEntries].face;
+		if (!polytope.faces[faceIndex].isRemoved)
+			return faceIndex;
 	}
-
-	return targetTriangleIndex;
+	return -1;
 }
 
 /*
 ================================
-IsAlreadyAdded
+FindHorizon_EPA
+
+Removes the face if the new point sees it and carries on through its other two edges,
+otherwise the edge we came through is on the horizon.
+The edges are visited in order, so the horizon comes out as one loop around the removed faces.
+Returns false if the removed faces are not bounded by a closed surface, or if the horizon is too long.
 ================================
 */
-bool IsAlreadyAdded(const Vec3& targetPoint, const std::vector< tri_t > triangles, const std::vector< point_t >& points) {
-	const float epsilons = 0.001f * 0.001f;
-	Vec3 delta;
+static bool FindHorizon_EPA(epaPolytope_t& polytope, const int faceIndex, const int edgeIndex, const Vec3& newPoint) {
+	if (faceIndex < 0)
+		return false;
 
-	for (int currentTriangleIndex = 0; currentTriangleIndex < triangles.size(); ++currentTriangleIndex) {
-		const tri_t& currentTriangle = triangles[currentTriangleIndex];
+	epaFace_t& face = polytope.faces[faceIndex];
+	if (face.isRemoved)
+		return true;
 
-		delta = targetPoint - points[currentTriangle.a].xyz;
-		if (delta.GetLengthSqr() < epsilons)
-			return true;
-		delta = targetPoint - points[currentTriangle.b].xyz;
-		if (delta.GetLengthSqr() < epsilons)
-			return true;
-		delta = targetPoint - points[currentTriangle.c].xyz;
-		if (delta.GetLengthSqr() < epsilons)
-			return true;
+	if (face.normal.Dot(newPoint) - face.distance <= 0.0f) {
+		if (polytope.numHorizonEdges >= epaPolytope_t::MAX_POINTS)
+			return false;
+
+		epaHorizonEdge_t& horizonEdge = polytope.horizon[polytope.numHorizonEdges++];
+		horizonEdge.face = faceIndex;
+		horizonEdge.edge = edgeIndex;
+		return true;
 	}
-	return false;
+
+	face.isRemoved = true;
+	for (int currentEdge = 1; currentEdge < 3; ++currentEdge) {
+		const int nextEdge = (edgeIndex + currentEdge) % 3;
+		if (!FindHorizon_EPA(polytope, face.adjacent[nextEdge], face.adjacentEdge[nextEdge], newPoint))
+			return false;
+	}
+	return true;
 }
 
 /*
 ================================
-RemoveTrianglesFacingPoint
+ExpandFace_EPA
+
+Replaces the faces the new point can see with a fan of faces from the horizon to the point.
+Returns false if the polytope could not be expanded, it is left as it was apart from the faces marked as removed.
 ================================
 */
-int RemoveTrianglesFacingPoint(const Vec3& targetPoint, std::vector< tri_t >& triangles, const std::vector< point_t >& points) {
-	int numOfRemovedTriangles = 0;
-	for (int currentTriangleIndex = 0; currentTriangleIndex < triangles.size(); ++currentTriangleIndex) {
-		const tri_t& currentTriangle = triangles[currentTriangleIndex];
+static bool ExpandFace_EPA(epaPolytope_t& polytope, const int closestFace, const int newPointIndex) {
+	const Vec3& newPoint = polytope.points[newPointIndex].xyz;
+	epaFace_t& face = polytope.faces[closestFace];
+
+	polytope.numHorizonEdges = 0;
+	face.isRemoved = true;
+	for (int currentEdge = 0; currentEdge < 3; ++currentEdge) {
+		if (!FindHorizon_EPA(polytope, face.adjacent[currentEdge], face.adjacentEdge[currentEdge], newPoint))
+			return false;
+	}
 
-		float distance = GetSignedDistanceFromPointToTriangle(currentTriangle, targetPoint, points);
-		if (distance > 0.0f) {
-			// This triangle faces the point.  Remove it.
-			triangles.erase(triangles.begin() + currentTriangleIndex);
-			--currentTriangleIndex;
-			numOfRemovedTriangles++;
-		}
+	// Every horizon edge has to start where the previous one ended
+	const int numHorizonEdges = polytope.numHorizonEdges;
+	if (numHorizonEdges < 3)
+		return false;
+	for (int currentEdge = 0; currentEdge < numHorizonEdges; ++currentEdge) {
+		const epaHorizonEdge_t& edge = polytope.horizon[currentEdge];
+		const epaHorizonEdge_t& nextEdge = polytope.horizon[(currentEdge + 1) % numHorizonEdges];
+		const int edgeStart = polytope.faces[edge.face].vertices[edge.edge];
+		const int nextEdgeEnd = polytope.faces[nextEdge.face].vertices[(nextEdge.edge + 1) % 3];
+		if (edgeStart != nextEdgeEnd)
+			return false;
+	}
+	if (polytope.numFaces + numHorizonEdges > epaPolytope_t::MAX_FACES)
+		return false;
+
+	// The new face runs the horizon edge backwards, so its edge 0 is shared with the face that stays
+	// and its edge 2 with edge 1 of the face before it
+	int firstFace = -1;
+	int previousFace = -1;
+	for (int currentEdge = 0; currentEdge < numHorizonEdges; ++currentEdge) {
+		const epaHorizonEdge_t& edge = polytope.horizon[currentEdge];
+		const epaFace_t& keptFace = polytope.faces[edge.face];
+		const int newFace = AddFace_EPA(polytope, keptFace.vertices[(edge.edge + 1) % 3], keptFace.vertices[edge.edge], newPointIndex);
+
+		LinkFaces_EPA(polytope, newFace, 0, edge.face, edge.edge);
+		if (previousFace >= 0)
+			LinkFaces_EPA(polytope, newFace, 2, previousFace, 1);
+		else
+			firstFace = newFace;
+		previousFace = newFace;
 	}
-	return numOfRemovedTriangles;
+	LinkFaces_EPA(polytope, firstFace, 2, previousFace, 1);
+	return true;
 }
 
 /*
 ================================
-FindDanglingEdges
+IsAlreadyAdded
 ================================
 */
-void FindDanglingEdges(std::vector< edge_t >& danglingEdges, const std::vector< tri_t >& triangles) {
-	danglingEdges.clear();
-
-	for (int currentTriangleIndex = 0; currentTriangleIndex < triangles.size(); ++currentTriangleIndex) {
-		const tri_t& currentTriangle = triangles[currentTriangleIndex];
-
-		edge_t edges[3];
-		edges[0].a = currentTriangle.a;
-		edges[0].b = currentTriangle.b;
-
-		edges[1].a = currentTriangle.b;
-		edges[1].b = currentTriangle.c;
-
-		edges[2].a = currentTriangle.c;
-		edges[2].b = currentTriangle.a;
-
-		int counts[3];
-		counts[0] = 0;
-		counts[1] = 0;
-		counts[2] = 0;
-
-		for (int currentNestedIndex = 0; currentNestedIndex < triangles.size(); ++currentNestedIndex) {
-			if (currentNestedIndex == currentTriangleIndex)
-				continue;
-
-			const tri_t& currentNestedTriangle = triangles[currentNestedIndex];
-
-			edge_t edgesNested[3];
-			edgesNested[0].a = currentNestedTriangle.a;
-			edgesNested[0].b = currentNestedTriangle.b;
-
-			edgesNested[1].a = currentNestedTriangle.b;
-			edgesNested[1].b = currentNestedTriangle.c;
-
-			edgesNested[2].a = currentNestedTriangle.c;
-			edgesNested[2].b = currentNestedTriangle.a;
-
-			for (int currentNestedNestedIndex = 0; currentNestedNestedIndex < 3; ++currentNestedNestedIndex) {
-				if (edges[currentNestedNestedIndex] == edgesNested[0]) 
-					counts[currentNestedNestedIndex]++;
-
-				if (edges[currentNestedNestedIndex] == edgesNested[1]) 
-					counts[currentNestedNestedIndex]++;
-
-				if (edges[currentNestedNestedIndex] == edgesNested[2]) 
-					counts[currentNestedNestedIndex]++;
-			}
-		}
-
-		// An edge that isn't shared, is dangling 
-		for (int currentNestedNestedIndex = 0; currentNestedNestedIndex < 3; ++currentNestedNestedIndex) {
-			if (0 == counts[currentNestedNestedIndex]) 
-				danglingEdges.push_back(edges[currentNestedNestedIndex]);
-		}
+static bool IsAlreadyAdded(const Vec3& targetPoint, const epaPolytope_t& polytope) {
+	const float epsilons = 0.001f * 0.001f;
+	for (int currentPoint = 0; currentPoint < polytope.numPoints; ++currentPoint) {
+		const Vec3 delta = targetPoint - polytope.points[currentPoint].xyz;
+		if (delta.GetLengthSqr() < epsilons)
+			return true;
 	}
+	return false;
 }
 
 /*
@@ -860,128 +1448,111 @@ void FindDanglingEdges(std::vector< edge_t >& danglingEdges, const std::vector<
 Expand_EPA
 ================================
 */
-float Expand_EPA(const Body* bodyA, const Body* bodyB, const float bias, const point_t simplexPoints[4], Vec3& pointOnA, Vec3& pointOnB) {
-	std::vector< point_t > points;
-	std::vector< tri_t > triangles;
-	std::vector< edge_t > danglingEdges;
-
-	Vec3 centerPoint(0.0f);
-	for (int currentVertex = 0; currentVertex < 4; ++currentVertex) {
-		points.push_back(simplexPoints[currentVertex]);
-		centerPoint += simplexPoints[currentVertex].xyz;
-	}
-	centerPoint *= 0.25f;
-
-	// Build the initial triangles from the simplex
-	for (int currentVertex = 0; currentVertex < 4; ++currentVertex) {
-		int vertexA = (currentVertex + 1) % 4;
-		int vertexB = (currentVertex + 2) % 4;
-		tri_t currentTriangle;
-		currentTriangle.a = currentVertex;
-		currentTriangle.b = vertexA;
-		currentTriangle.c = vertexB;
-
-		int unusedPoint = (currentVertex + 3) % 4;
-		float distance = GetSignedDistanceFromPointToTriangle(currentTriangle, points[unusedPoint].xyz, points);
-
-		// The unused point is always on the negative/inside of the triangle.. make sure the normal points away
-		if (distance > 0.0f)
-			std::swap(currentTriangle.a, currentTriangle.b);
-
-		triangles.push_back(currentTriangle);
-	}
+float Expand_EPA(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, const float bias, const point_t simplexPoints[4], Vec3& pointOnA, Vec3& pointOnB, gjkCache_t* cache) {
+	epaPolytope_t polytope;
+	polytope.numPoints = 0;
+	polytope.numFaces = 0;
+	polytope.numHeapEntries = 0;
+	polytope.numHorizonEdges = 0;
+
+	for (int currentVertex = 0; currentVertex < 4; ++currentVertex)
+		polytope.points[polytope.numPoints++] = simplexPoints[currentVertex];
+
+	// Build the initial triangles from the simplex, with the normals pointing away from the fourth point
+	const Vec3& s1 = simplexPoints[0].xyz;
+	const bool isFlipped = (simplexPoints[1].xyz - s1).Cross(simplexPoints[2].xyz - s1).Dot(simplexPoints[3].xyz - s1) > 0.0f;
+	const int a = isFlipped ? 1 : 0;
+	const int b = isFlipped ? 0 : 1;
+	AddFace_EPA(polytope, a, b, 2);
+	AddFace_EPA(polytope, b, a, 3);
+	AddFace_EPA(polytope, 2, b, 3);
+	AddFace_EPA(polytope, a, 2, 3);
+	LinkFaces_EPA(polytope, 0, 0, 1, 0);
+	LinkFaces_EPA(polytope, 0, 1, 2, 0);
+	LinkFaces_EPA(polytope, 0, 2, 3, 0);
+	LinkFaces_EPA(polytope, 1, 1, 3, 2);
+	LinkFaces_EPA(polytope, 1, 2, 2, 1);
+	LinkFaces_EPA(polytope, 2, 2, 3, 1);
 
 	// [Safety Fix] Limit the number of iterations to prevent infinite loops.
 	// In stress tests with many objects, floating-point errors can cause EPA to loop forever.
 	// 32 to 64 iterations are usually sufficient for high precision.
-	const int EPA_MAX_ITERATIONS = 64;
 	const float EPA_TOLERANCE = 0.0001f; // Threshold for small expansions
 
-	for (int iteration = 0; iteration < EPA_MAX_ITERATIONS; ++iteration) {
-		const int closestTriangleIndex = GetClosestTriangleToOrigin(triangles, points);
-
-		// [Safety Fix] Ensure the index is valid.
-		if (closestTriangleIndex < 0 || closestTriangleIndex >= triangles.size()) {
+	int closestFace = -1;
+	for (int iteration = 0; iteration < epaPolytope_t::MAX_ITERATIONS; ++iteration) {
+		closestFace = PopClosestFace_EPA(polytope);
+		if (closestFace < 0)
 			break;
-		}
 
-		Vec3 normal = GetNormalOfTriangle(triangles[closestTriangleIndex], points);
-		const point_t newSupportPoint = GetSupportPoint(bodyA, bodyB, normal, bias);
+		const epaFace_t& face = polytope.faces[closestFace];
+		const point_t newSupportPoint = GetSupportPoint(bodyA, bodyB, face.normal, bias, cache);
 
 		// If the point already exists, we can't expand further.
-		if (IsAlreadyAdded(newSupportPoint.xyz, triangles, points))
+		if (IsAlreadyAdded(newSupportPoint.xyz, polytope))
 			break;
 
-		float distance = GetSignedDistanceFromPointToTriangle(triangles[closestTriangleIndex], newSupportPoint.xyz, points);
-
 		// [Safety Fix] If the expansion distance is negligible, stop to save performance and prevent errors.
+		const float distance = face.normal.Dot(newSupportPoint.xyz) - face.distance;
 		if (distance <= EPA_TOLERANCE)
 			break;
 
-		const int newSupportPointIndex = (int)points.size();
-		points.push_back(newSupportPoint);
-
-		// Remove Triangles that face this point
-		int numOfRemovedTriangles = RemoveTrianglesFacingPoint(newSupportPoint.xyz, triangles, points);
-		if (0 == numOfRemovedTriangles)
-			break;
+		const int newSupportPointIndex = polytope.numPoints++;
+		polytope.points[newSupportPointIndex] = newSupportPoint;
 
-		// Find Dangling Edges
-		danglingEdges.clear();
-		FindDanglingEdges(danglingEdges, triangles);
-		if (0 == danglingEdges.size())
+		// Nothing was changed, the closest face is still the answer
+		if (!ExpandFace_EPA(polytope, closestFace, newSupportPointIndex))
 			break;
-
-		// Reconstruct the polytope with new triangles
-		for (int currentEdgeIndex = 0; currentEdgeIndex < danglingEdges.size(); ++currentEdgeIndex) {
-			const edge_t& currentEdge = danglingEdges[currentEdgeIndex];
-
-			tri_t currentTriangle;
-			currentTriangle.a = newSupportPointIndex;
-			currentTriangle.b = currentEdge.b;
-			currentTriangle.c = currentEdge.a;
-
-			// Make sure it's oriented properly
-			float distance = GetSignedDistanceFromPointToTriangle(currentTriangle, centerPoint, points);
-			if (distance > 0.0f)
-				std::swap(currentTriangle.b, currentTriangle.c);
-
-			triangles.push_back(currentTriangle);
-		}
+		closestFace = -1;
 	}
 
+	// Ran out of iterations, the closest face of the last expansion is the answer
+	if (closestFace < 0)
+		closestFace = PopClosestFace_EPA(polytope);
+
 	// [Safety Fix] If something went wrong and we have no triangles left, return 0 depth.
-	if (triangles.empty())
+	if (closestFace < 0)
 		return 0.0f;
 
 	// Get the projection of the origin on the closest triangle
-	const int closestTriangleIndex = GetClosestTriangleToOrigin(triangles, points);
-
-	// [Safety Fix] Ensure index is valid before access
-	if (closestTriangleIndex < 0) 
-		return 0.0f;
-
-	const tri_t& closestTriangle = triangles[closestTriangleIndex];
-	Vec3 triangleVertexA = points[closestTriangle.a].xyz;
-	Vec3 triangleVertexB = points[closestTriangle.b].xyz;
-	Vec3 triangleVertexC = points[closestTriangle.c].xyz;
+	const epaFace_t& face = polytope.faces[closestFace];
+	const point_t& vertexA = polytope.points[face.vertices[0]];
+	const point_t& vertexB = polytope.points[face.vertices[1]];
+	const point_t& vertexC = polytope.points[face.vertices[2]];
 
 	// Calculate barycentric coordinates using the robust version
-	Vec3 lambdas = GetBarycentricCoordinates(triangleVertexA, triangleVertexB, triangleVertexC, Vec3(0.0f));
+	Vec3 lambdas = GetBarycentricCoordinates(vertexA.xyz, vertexB.xyz, vertexC.xyz, Vec3(0.0f));
 
 	// Get the point on shape A
-	Vec3 shapeA_VertexA = points[closestTriangle.a].ptA;
-	Vec3 shapeA_VertexB = points[closestTriangle.b].ptA;
-	Vec3 shapeA_VertexC = points[closestTriangle.c].ptA;
-	pointOnA = shapeA_VertexA * lambdas[0] + shapeA_VertexB * lambdas[1] + shapeA_VertexC * lambdas[2];
+	pointOnA = vertexA.ptA * lambdas[0] + vertexB.ptA * lambdas[1] + vertexC.ptA * lambdas[2];
 
 	// Get the point on shape B
-	Vec3 shapeB_VertexA = points[closestTriangle.a].ptB;
-	Vec3 shapeB_VertexB = points[closestTriangle.b].ptB;
-	Vec3 shapeB_VertexC = points[closestTriangle.c].ptB;
-	pointOnB = shapeB_VertexA * lambdas[0] + shapeB_VertexB * lambdas[1] + shapeB_VertexC * lambdas[2];
+	pointOnB = vertexA.ptB * lambdas[0] + vertexB.ptB * lambdas[1] + vertexC.ptB * lambdas[2];
 
 	// Return the penetration distance
 	Vec3 delta = pointOnB - pointOnA;
 	return delta.GetMagnitude();
-}
\ No newline at end of file
+}
+
+/*
+================================
+Body overloads
+
+The queries only read the pose of the bodies, so they run on transforms.
+================================
+*/
+bool DoesIntersect_GJK(const Body* bodyA, const Body* bodyB) {
+	const bodyTransform_t transformA = bodyA->GetTransform();
+	const bodyTransform_t transformB = bodyB->GetTransform();
+	return DoesIntersect_GJK(&transformA, &transformB);
+}
+bool DoesIntersect_GJK(const Body* bodyA, const Body* bodyB, const float bias, Vec3& contactPointOnA, Vec3& contactPointOnB) {
+	const bodyTransform_t transformA = bodyA->GetTransform();
+	const bodyTransform_t transformB = bodyB->GetTransform();
+	return DoesIntersect_GJK(&transformA, &transformB, bias, contactPointOnA, contactPointOnB);
+}
+void FindClosestPoints_GJK(const Body* bodyA, const Body* bodyB, Vec3& pointOnA, Vec3& pointOnB) {
+	const bodyTransform_t transformA = bodyA->GetTransform();
+	const bodyTransform_t transformB = bodyB->GetTransform();
+	FindClosestPoints_GJK(&transformA, &transformB, pointOnA, pointOnB);
+}
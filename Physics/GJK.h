@@ -7,3 +7,56 @@
 bool DoesIntersect_GJK( const Body * bodyA, const Body * bodyB );
 bool DoesIntersect_GJK( const Body * bodyA, const Body * bodyB, const float bias, Vec3 & ptOnA, Vec3 & ptOnB );
 void FindClosestPoints_GJK( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB );
+
+/*
+====================================================
+gjkCache_t
+
+Where the last query on a pair ended, kept per pair (keyed like the manifolds) by the narrowphase.
+The next query starts searching from there, for resting or slowly moving pairs
+that direction already separates the shapes or is close to it.
+====================================================
+*/
+struct gjkCache_t {
+	gjkCache_t() : isValid( false ), supportVertexA( -1 ), supportVertexB( -1 ) {}
+
+	Vec3 direction;		// the last search direction in the minkowski difference A - B
+	bool isValid;
+
+	// the last support points of shapes made of points, so the next search climbs from there (-1 for none)
+	int supportVertexA;
+	int supportVertexB;
+};
+
+// same queries on transforms that may have been advanced in time, the bodies are not touched
+// the cache is optional, it is read and updated when given
+bool DoesIntersect_GJK( const bodyTransform_t * bodyA, const bodyTransform_t * bodyB, gjkCache_t * cache = nullptr );
+bool DoesIntersect_GJK( const bodyTransform_t * bodyA, const bodyTransform_t * bodyB, const float bias, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache = nullptr );
+void FindClosestPoints_GJK( const bodyTransform_t * bodyA, const bodyTransform_t * bodyB, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache = nullptr );
+
+// DoesIntersect_GJK and FindClosestPoints_GJK in one GJK run: true with the EPA contact points when the shapes overlap,
+// false with the closest points when they are apart
+bool FindContactPoints_GJK( const bodyTransform_t * bodyA, const bodyTransform_t * bodyB, const float bias, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache = nullptr );
+
+// FindClosestPoints_GJK on the cores of the shapes (see Shape::GetMargin),
+// false when the cores overlap and the closest points of the cores otherwise
+bool FindCoreClosestPoints_GJK( const bodyTransform_t * bodyA, const bodyTransform_t * bodyB, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache = nullptr );
+
+/*
+====================================================
+gjkBatchPair_t
+
+One pair of hulls for AreSeparated_GJKBatch, both shapes are ShapeConvex
+====================================================
+*/
+struct gjkBatchPair_t {
+	const Body * bodyA;
+	const Body * bodyB;
+	float minDistance;
+	gjkCache_t * cache;		// optional, read and updated like the other queries do
+	bool isSeparated;		// the answer, true when the hulls are proven to be further apart than minDistance
+};
+
+// GJK on many pairs of hulls at once, one pair per SIMD lane. A pair that is not proven apart
+// may still be apart, it only needs the full query. Without SSE no pair is proven apart.
+void AreSeparated_GJKBatch( gjkBatchPair_t * pairs, const int count );
@@ -4,6 +4,8 @@
 #include "PCH.h"
 #include "Intersections.h"
 #include "GJK.h"
+#include "SAT.h"
+#include "../Math/SIMD.h"
 
 
 /*
@@ -112,85 +114,386 @@ bool DoesIntersect_SphereSphereStatic(const ShapeSphere* sphereA, const ShapeSph
 }
 /*
 ====================================================
-DoesIntersect
+Contact functions
+
+One function per pair of shape types. They fill the world space points, the normal
+(from B towards A) and the separation even when the shapes are apart,
+because conservative advancement steps the bodies by the separation.
 ====================================================
 */
-bool DoesIntersect(Body* bodyA, Body* bodyB, contact_t& contact) {
-	contact.bodyA = bodyA;
-	contact.bodyB = bodyB;
-	contact.timeOfImpact = 0.0f;
+typedef bool (*contactFunction_t)(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t& contact);
 
-	if (bodyA->m_shape->GetType() == Shape::SHAPE_SPHERE && bodyB->m_shape->GetType() == Shape::SHAPE_SPHERE) {
-		const ShapeSphere* sphereA = (const ShapeSphere*)bodyA->m_shape;
-		const ShapeSphere* sphereB = (const ShapeSphere*)bodyB->m_shape;
+// cores closer than this are treated as overlapping, the direction between them is not reliable
+static const float CORE_EPSILON = 0.0001f;
 
-		Vec3 posA = bodyA->m_position;
-		Vec3 posB = bodyB->m_position;
+/*
+====================================================
+Contact_SphereSphere
+====================================================
+*/
+static bool Contact_SphereSphere(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t& contact) {
+	const ShapeSphere* sphereA = (const ShapeSphere*)bodyA->shape;
+	const ShapeSphere* sphereB = (const ShapeSphere*)bodyB->shape;
 
-		if (DoesIntersect_SphereSphereStatic(sphereA, sphereB, posA, posB, contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace)) {
-			contact.normal = posA - posB;
-			contact.normal.Normalize();
+	Vec3 posA = bodyA->position;
+	Vec3 posB = bodyB->position;
 
-			contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
-			contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+	const bool didIntersect = DoesIntersect_SphereSphereStatic(sphereA, sphereB, posA, posB, contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace);
 
-			Vec3 ab = bodyB->m_position - bodyA->m_position;
-			float r = ab.GetMagnitude() - (sphereA->m_radius + sphereB->m_radius);
-			contact.separationDistance = r;
-			return true;
+	contact.normal = posA - posB;
+	contact.normal.Normalize();
+
+	Vec3 ab = posB - posA;
+	contact.separationDistance = ab.GetMagnitude() - (sphereA->m_radius + sphereB->m_radius);
+	return didIntersect;
+}
+
+/*
+====================================================
+Contact_SphereBox
+
+Clamps the sphere center to the box in the box's space, where the box is axis aligned.
+A center inside the box is pushed out through the nearest face.
+====================================================
+*/
+static bool Contact_SphereBox(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t& contact) {
+	const ShapeSphere* sphere = (const ShapeSphere*)bodyA->shape;
+	const ShapeBox* box = (const ShapeBox*)bodyB->shape;
+	const Bounds& bounds = box->m_bounds;
+
+	const Vec3 center = bodyB->orientation.Inverse().RotatePoint(bodyA->position - bodyB->position);
+
+	Vec3 closestPoint;
+	for (int axis = 0; axis < 3; ++axis)
+		closestPoint[axis] = std::max(bounds.mins[axis], std::min(center[axis], bounds.maxs[axis]));
+
+	Vec3 normal = center - closestPoint;
+	float distance = normal.GetMagnitude();
+	if (distance > 0.0f)
+		normal /= distance;
+	else {
+		float minDepth = 1e10f;
+		for (int axis = 0; axis < 3; ++axis) {
+			const float depthToMin = center[axis] - bounds.mins[axis];
+			const float depthToMax = bounds.maxs[axis] - center[axis];
+			if (depthToMin < minDepth) {
+				minDepth = depthToMin;
+				normal.Zero();
+				normal[axis] = -1.0f;
+				closestPoint = center;
+				closestPoint[axis] = bounds.mins[axis];
+			}
+			if (depthToMax < minDepth) {
+				minDepth = depthToMax;
+				normal.Zero();
+				normal[axis] = 1.0f;
+				closestPoint = center;
+				closestPoint[axis] = bounds.maxs[axis];
+			}
 		}
+		distance = -minDepth;
 	}
-	else {
-		Vec3 ptOnA;
-		Vec3 ptOnB;
-		const float bias = 0.001f;
-		if (DoesIntersect_GJK(bodyA, bodyB, bias, ptOnA, ptOnB)) {
-			// There was an intersection, so get the contact data
-			Vec3 normal = ptOnB - ptOnA;
-			normal.Normalize();
 
-			ptOnA -= normal * bias;
-			ptOnB += normal * bias;
+	contact.normal = bodyB->orientation.RotatePoint(normal);
+	contact.ptOnA_WorldSpace = bodyA->position - contact.normal * sphere->m_radius;
+	contact.ptOnB_WorldSpace = bodyB->position + bodyB->orientation.RotatePoint(closestPoint);
+	contact.separationDistance = distance - sphere->m_radius;
+	return (contact.separationDistance <= CONTACT_BIAS);
+}
 
-			contact.normal = normal;
+/*
+====================================================
+Contact_PolytopesPastMargins
 
-			contact.ptOnA_WorldSpace = ptOnA;
-			contact.ptOnB_WorldSpace = ptOnB;
+Contact_Polytopes once the cores overlap: GJK for the closest points, and EPA once the shapes overlap.
+Both come from the same GJK run.
+====================================================
+*/
+static bool Contact_PolytopesPastMargins(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t& contact) {
+	Vec3 ptOnA;
+	Vec3 ptOnB;
 
-			contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
-			contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+	const float bias = CONTACT_BIAS;
+	if (FindContactPoints_GJK(bodyA, bodyB, bias, ptOnA, ptOnB, cache)) {
+		// There was an intersection, so get the contact data
+		Vec3 normal = ptOnB - ptOnA;
+		normal.Normalize();
 
-			Vec3 ab = bodyB->m_position - bodyA->m_position;
-			float r = (ptOnA - ptOnB).GetMagnitude();
-			contact.separationDistance = -r;
-			return true;
-		}
+		ptOnA -= normal * bias;
+		ptOnB += normal * bias;
+
+		contact.normal = normal;
 
-		// There was no collision, but we still want the contact data, so get it
-		FindClosestPoints_GJK(bodyA, bodyB, ptOnA, ptOnB);
 		contact.ptOnA_WorldSpace = ptOnA;
 		contact.ptOnB_WorldSpace = ptOnB;
 
-		contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
-		contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
-
-		Vec3 ab = bodyB->m_position - bodyA->m_position;
 		float r = (ptOnA - ptOnB).GetMagnitude();
-		contact.separationDistance = r;
+		contact.separationDistance = -r;
+		return true;
 	}
+
+	// There was no collision, the points are the closest ones
+	contact.ptOnA_WorldSpace = ptOnA;
+	contact.ptOnB_WorldSpace = ptOnB;
+
+	float r = (ptOnA - ptOnB).GetMagnitude();
+	contact.separationDistance = r;
 	return false;
 }
 
+/*
+====================================================
+Contact_Polytopes
+
+The polytopes are handled as their cores with the margins around them first.
+While the cores are apart, their closest points pushed out by the margins are the contact,
+so shallow contacts come straight from GJK.
+====================================================
+*/
+static bool Contact_Polytopes(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t& contact) {
+	Vec3 ptOnA;
+	Vec3 ptOnB;
+
+	const float marginA = bodyA->shape->GetMargin();
+	const float marginB = bodyB->shape->GetMargin();
+	if (marginA + marginB > 0.0f && FindCoreClosestPoints_GJK(bodyA, bodyB, ptOnA, ptOnB, cache)) {
+		Vec3 normal = ptOnA - ptOnB;
+		const float distance = normal.GetMagnitude();
+
+		// Cores that only just touch have no direction between them
+		if (distance > CORE_EPSILON) {
+			normal = normal / distance;
+			contact.normal = normal;
+			contact.ptOnA_WorldSpace = ptOnA - normal * marginA;
+			contact.ptOnB_WorldSpace = ptOnB + normal * marginB;
+			contact.separationDistance = distance - marginA - marginB;
+			return (contact.separationDistance <= CONTACT_BIAS);
+		}
+	}
+
+	return Contact_PolytopesPastMargins(bodyA, bodyB, cache, contact);
+}
+
+/*
+====================================================
+Contact_SphereConvex
+
+The sphere is handled as its center point with the radius as a margin,
+so GJK only has to find the closest point of the hull to a point.
+Falls back to the full GJK/EPA when the center is inside the hull.
+====================================================
+*/
+static bool Contact_SphereConvex(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t& contact) {
+	static const ShapeSphere centerShape(0.0f);
+	const ShapeSphere* sphere = (const ShapeSphere*)bodyA->shape;
+
+	bodyTransform_t center = *bodyA;
+	center.shape = &centerShape;
+
+	Vec3 ptOnCenter;
+	Vec3 ptOnHull;
+	// the closest direction of the center is the one of the whole sphere, so both share the cache
+	FindClosestPoints_GJK(&center, bodyB, ptOnCenter, ptOnHull, cache);
+
+	Vec3 normal = bodyA->position - ptOnHull;
+	const float distance = normal.GetMagnitude();
+	if (distance > CONTACT_BIAS) {
+		normal /= distance;
+
+		// The closest point is only right if the whole hull is behind the plane through it
+		const Vec3 support = bodyB->shape->GetSupportPoint(normal, bodyB->position, bodyB->orientation, 0.0f);
+		if (normal.Dot(support - ptOnHull) <= CONTACT_BIAS) {
+			contact.normal = normal;
+			contact.ptOnA_WorldSpace = bodyA->position - normal * sphere->m_radius;
+			contact.ptOnB_WorldSpace = ptOnHull;
+			contact.separationDistance = distance - sphere->m_radius;
+			return (contact.separationDistance <= CONTACT_BIAS);
+		}
+	}
+
+	return Contact_Polytopes(bodyA, bodyB, cache, contact);
+}
+
+/*
+====================================================
+Contact_BoxBox
+
+The deepest point of the SAT manifold, GJK finds the closest points once the boxes are apart.
+====================================================
+*/
+static bool Contact_BoxBox(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t& contact) {
+	contact_t contacts[MAX_MANIFOLD_CONTACTS];
+	const int numContacts = FindContacts_BoxBox(bodyA, bodyB, contacts);
+	if (0 == numContacts)
+		return Contact_Polytopes(bodyA, bodyB, cache, contact);
+
+	int deepest = 0;
+	for (int currentIndex = 1; currentIndex < numContacts; ++currentIndex) {
+		if (contacts[currentIndex].separationDistance < contacts[deepest].separationDistance)
+			deepest = currentIndex;
+	}
+	contact.normal = contacts[deepest].normal;
+	contact.ptOnA_WorldSpace = contacts[deepest].ptOnA_WorldSpace;
+	contact.ptOnB_WorldSpace = contacts[deepest].ptOnB_WorldSpace;
+	contact.separationDistance = contacts[deepest].separationDistance;
+	return true;
+}
+
+/*
+====================================================
+Contact_Swapped
+
+Runs a function written for (B, A) and flips the result back to (A, B).
+====================================================
+*/
+template <contactFunction_t function>
+static bool Contact_Swapped(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t& contact) {
+	const bool didIntersect = function(bodyB, bodyA, cache, contact);
+	std::swap(contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace);
+	contact.normal *= -1.0f;
+	return didIntersect;
+}
+
+static const int NUM_SHAPE_TYPES = Shape::SHAPE_CONVEX + 1;
+
+// indexed by [ type of A ][ type of B ]
+static const contactFunction_t s_contactFunctions[NUM_SHAPE_TYPES][NUM_SHAPE_TYPES] = {
+	// SHAPE_SPHERE									SHAPE_BOX								SHAPE_CONVEX
+	{ Contact_SphereSphere,							Contact_SphereBox,						Contact_SphereConvex },	// SHAPE_SPHERE
+	{ Contact_Swapped<Contact_SphereBox>,			Contact_BoxBox,							Contact_Polytopes },	// SHAPE_BOX
+	{ Contact_Swapped<Contact_SphereConvex>,		Contact_Polytopes,						Contact_Polytopes },	// SHAPE_CONVEX
+};
+
+/*
+====================================================
+Manifold functions
+
+Pairs that can build a whole manifold at once when they touch, nullptr for the others.
+Same conventions as the contact functions, they return the number of contacts.
+When the shapes are apart they return 0 and leave the closest points in contacts[ 0 ],
+the same ones the contact function of the pair finds, so conservative advancement can start from them.
+====================================================
+*/
+typedef int (*manifoldFunction_t)(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t* contacts);
+
+/*
+====================================================
+Manifold_BoxBox
+
+Boxes the SAT finds apart go to GJK for their closest points, as in Contact_BoxBox.
+====================================================
+*/
+static int Manifold_BoxBox(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t* contacts) {
+	const int numContacts = FindContacts_BoxBox(bodyA, bodyB, contacts);
+	if (numContacts > 0)
+		return numContacts;
+
+	return Contact_Polytopes(bodyA, bodyB, cache, contacts[0]) ? 1 : 0;
+}
+
+/*
+====================================================
+Manifold_ConvexConvex
+
+The full separating axis test walks every edge pair that passes the Gauss map test, which costs far more
+than GJK for hulls with many points. The warm started core query settles most pairs first:
+cores further apart than the margins are not touching, and a shallow contact only needs the faces
+along its normal clipped (or is a single edge or corner contact). Only cores that overlap take the full test.
+====================================================
+*/
+static int Manifold_ConvexConvex(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t* contacts) {
+	const float marginA = bodyA->shape->GetMargin();
+	const float marginB = bodyB->shape->GetMargin();
+
+	Vec3 ptOnA;
+	Vec3 ptOnB;
+	if (marginA + marginB > 0.0f && FindCoreClosestPoints_GJK(bodyA, bodyB, ptOnA, ptOnB, cache)) {
+		Vec3 normal = ptOnA - ptOnB;
+		const float distance = normal.GetMagnitude();
+		if (distance > CORE_EPSILON) {
+			normal /= distance;
+			const float separation = distance - marginA - marginB;
+			if (separation <= CONTACT_BIAS) {
+				const int numContacts = FindContacts_ConvexFaces(bodyA, bodyB, normal, contacts);
+				if (numContacts > 0)
+					return numContacts;
+			}
+
+			// a single edge or corner contact, or the closest points when apart
+			contact_t& contact = contacts[0];
+			contact.normal = normal;
+			contact.ptOnA_WorldSpace = ptOnA - normal * marginA;
+			contact.ptOnB_WorldSpace = ptOnB + normal * marginB;
+			contact.separationDistance = separation;
+			return (separation <= CONTACT_BIAS) ? 1 : 0;
+		}
+	}
+
+	const int numContacts = FindContacts_ConvexConvex(bodyA, bodyB, contacts);
+	if (numContacts > 0)
+		return numContacts;
+
+	// the cores overlap, so Contact_Polytopes would go past the margins as well
+	return Contact_PolytopesPastMargins(bodyA, bodyB, cache, contacts[0]) ? 1 : 0;
+}
+
+// indexed by [ type of A ][ type of B ]
+static const manifoldFunction_t s_manifoldFunctions[NUM_SHAPE_TYPES][NUM_SHAPE_TYPES] = {
+	// SHAPE_SPHERE		SHAPE_BOX			SHAPE_CONVEX
+	{ nullptr,			nullptr,			nullptr },					// SHAPE_SPHERE
+	{ nullptr,			Manifold_BoxBox,	nullptr },					// SHAPE_BOX
+	{ nullptr,			nullptr,			Manifold_ConvexConvex },	// SHAPE_CONVEX
+};
+
+/*
+====================================================
+DoesIntersect_Transforms
+
+Fills the contact for the bodies at the given transforms, the body pointers are left alone.
+====================================================
+*/
+static bool DoesIntersect_Transforms(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, gjkCache_t* cache, contact_t& contact) {
+	contact.timeOfImpact = 0.0f;
+
+	const contactFunction_t function = s_contactFunctions[bodyA->shape->GetType()][bodyB->shape->GetType()];
+	const bool didIntersect = function(bodyA, bodyB, cache, contact);
+
+	contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+	contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+	return didIntersect;
+}
+
+/*
+====================================================
+DoesIntersect
+====================================================
+*/
+bool DoesIntersect(Body* bodyA, Body* bodyB, contact_t& contact) {
+	contact.bodyA = bodyA;
+	contact.bodyB = bodyB;
+
+	const bodyTransform_t transformA = bodyA->GetTransform();
+	const bodyTransform_t transformB = bodyB->GetTransform();
+	return DoesIntersect_Transforms(&transformA, &transformB, nullptr, contact);
+}
+
 
 /*
 ====================================================
 DoesIntersect_ConservativeAdvance
+
+Advances copies of the transforms, so the bodies are never moved and nothing has to be unwound.
+With isApartAtStart the contact already holds the closest points of the current transforms
+and the bodies are known to be apart, so the first test is skipped.
 ====================================================
 */
-bool DoesIntersect_ConservativeAdvance(Body* bodyA, Body* bodyB, float deltaTime, contact_t& contact) {
+bool DoesIntersect_ConservativeAdvance(Body* bodyA, Body* bodyB, float deltaTime, gjkCache_t* cache, contact_t& contact, const bool isApartAtStart = false) {
 	contact.bodyA = bodyA;
 	contact.bodyB = bodyB;
 
+	bodyTransform_t transformA = bodyA->GetTransform();
+	bodyTransform_t transformB = bodyB->GetTransform();
+
 	float toi = 0.0f;
 
 	int currentIterationCount = 0;
@@ -198,12 +501,12 @@ bool DoesIntersect_ConservativeAdvance(Body* bodyA, Body* bodyB, float deltaTime
 	// Advance the positions of the bodies until they touch or there's not time left
 	while (deltaTime > 0.0f) {
 		// Check for intersection
-		bool didIntersect = DoesIntersect(bodyA, bodyB, contact);
-		if (didIntersect) {
-			contact.timeOfImpact = toi;
-			bodyA->Update(-toi);
-			bodyB->Update(-toi);
-			return true;
+		if (!isApartAtStart || currentIterationCount > 0) {
+			bool didIntersect = DoesIntersect_Transforms(&transformA, &transformB, cache, contact);
+			if (didIntersect) {
+				contact.timeOfImpact = toi;
+				return true;
+			}
 		}
 
 		++currentIterationCount;
@@ -215,12 +518,12 @@ bool DoesIntersect_ConservativeAdvance(Body* bodyA, Body* bodyB, float deltaTime
 		ab.Normalize();
 
 		// project the relative velocity onto the ray of shortest distance
-		Vec3 relativeVelocity = bodyA->m_linearVelocity - bodyB->m_linearVelocity;
+		Vec3 relativeVelocity = transformA.linearVelocity - transformB.linearVelocity;
 		float orthoSpeed = relativeVelocity.Dot(ab);
 
 		// Add to the orthoSpeed the maximum angular speeds of the relative shapes
-		float angularSpeedA = bodyA->m_shape->GetFastestLinearSpeed(bodyA->m_angularVelocity, ab);
-		float angularSpeedB = bodyB->m_shape->GetFastestLinearSpeed(bodyB->m_angularVelocity, ab * -1.0f);
+		float angularSpeedA = transformA.shape->GetFastestLinearSpeed(transformA.angularVelocity, ab);
+		float angularSpeedB = transformB.shape->GetFastestLinearSpeed(transformB.angularVelocity, ab * -1.0f);
 		orthoSpeed += angularSpeedA + angularSpeedB;
 		if (orthoSpeed <= 0.0f) 
 			break;
@@ -231,13 +534,10 @@ bool DoesIntersect_ConservativeAdvance(Body* bodyA, Body* bodyB, float deltaTime
 
 		deltaTime -= timeToGo;
 		toi += timeToGo;
-		bodyA->Update(timeToGo);
-		bodyB->Update(timeToGo);
+		transformA.Update(timeToGo);
+		transformB.Update(timeToGo);
 	}
 
-	// unwind the clock
-	bodyA->Update(-toi);
-	bodyB->Update(-toi);
 	return false;
 }
 /*
@@ -245,7 +545,7 @@ bool DoesIntersect_ConservativeAdvance(Body* bodyA, Body* bodyB, float deltaTime
 DoesIntersect
 ====================================================
 */
-bool DoesIntersect(Body* bodyA, Body* bodyB, const float deltaTime, contact_t& contact) {
+bool DoesIntersect(Body* bodyA, Body* bodyB, const float deltaTime, contact_t& contact, gjkCache_t* cache) {
 	contact.bodyA = bodyA;
 	contact.bodyB = bodyB;
 
@@ -260,32 +560,265 @@ bool DoesIntersect(Body* bodyA, Body* bodyB, const float deltaTime, contact_t& c
 		Vec3 velB = bodyB->m_linearVelocity;
 
 		if (DoesIntersect_SphereSphereDynamic(sphereA, sphereB, posA, posB, velA, velB, deltaTime, contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace, contact.timeOfImpact)) {
-			// Step bodies forward to get local space collision points
-			bodyA->Update(contact.timeOfImpact);
-			bodyB->Update(contact.timeOfImpact);
-
-			// Convert world space contacts to local space
-			contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
-			contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
-
-			contact.normal = bodyA->m_position - bodyB->m_position;
-			contact.normal.Normalize();
-
-			// Unwind time step
-			bodyA->Update(-contact.timeOfImpact);
-			bodyB->Update(-contact.timeOfImpact);
-
-			// Calculate the separation distance
-			Vec3 ab = bodyB->m_position - bodyA->m_position;
-			float distance = ab.GetMagnitude() - (sphereA->m_radius + sphereB->m_radius);
-			contact.separationDistance = distance;
+			GetContact_SphereSphere(bodyA, bodyB, contact.timeOfImpact, contact);
 			return true;
 		}
 	}
 	else {
 		// Use GJK to perform conservative advancement
-		bool result = DoesIntersect_ConservativeAdvance(bodyA, bodyB, deltaTime, contact);
+		bool result = DoesIntersect_ConservativeAdvance(bodyA, bodyB, deltaTime, cache, contact);
 		return result;
 	}
 	return false;
 }
+
+/*
+====================================================
+FindContacts
+====================================================
+*/
+int FindContacts(Body* bodyA, Body* bodyB, const float deltaTime, contact_t contacts[MAX_MANIFOLD_CONTACTS], gjkCache_t* cache) {
+	const manifoldFunction_t function = s_manifoldFunctions[bodyA->m_shape->GetType()][bodyB->m_shape->GetType()];
+	if (nullptr != function) {
+		// Already touching, so the time of impact is zero and the manifold is all we need
+		const bodyTransform_t transformA = bodyA->GetTransform();
+		const bodyTransform_t transformB = bodyB->GetTransform();
+		const int numContacts = function(&transformA, &transformB, cache, contacts);
+		for (int currentIndex = 0; currentIndex < numContacts; ++currentIndex) {
+			contact_t& contact = contacts[currentIndex];
+			contact.bodyA = bodyA;
+			contact.bodyB = bodyB;
+			contact.timeOfImpact = 0.0f;
+			contact.ptOnA_LocalSpace = transformA.WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+			contact.ptOnB_LocalSpace = transformB.WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+		}
+		if (numContacts > 0)
+			return numContacts;
+
+		// Apart for now, the closest points the manifold function found are the first step of the advancement
+		return DoesIntersect_ConservativeAdvance(bodyA, bodyB, deltaTime, cache, contacts[0], true) ? 1 : 0;
+	}
+
+	return DoesIntersect(bodyA, bodyB, deltaTime, contacts[0], cache) ? 1 : 0;
+}
+
+/*
+====================================================
+GetContact_SphereSphere
+
+The points are where the spheres are at the time of impact. Spheres that already touch
+need no stepping, only the ones that touch later are stepped there for the local space points.
+====================================================
+*/
+void GetContact_SphereSphere(Body* bodyA, Body* bodyB, const float timeOfImpact, contact_t& contact) {
+	const ShapeSphere* sphereA = (const ShapeSphere*)bodyA->m_shape;
+	const ShapeSphere* sphereB = (const ShapeSphere*)bodyB->m_shape;
+
+	contact.bodyA = bodyA;
+	contact.bodyB = bodyB;
+	contact.timeOfImpact = timeOfImpact;
+
+	bodyTransform_t transformA = bodyA->GetTransform();
+	bodyTransform_t transformB = bodyB->GetTransform();
+	if (timeOfImpact > 0.0f) {
+		transformA.Update(timeOfImpact);
+		transformB.Update(timeOfImpact);
+	}
+
+	Vec3 ab = (bodyB->m_position + bodyB->m_linearVelocity * timeOfImpact) - (bodyA->m_position + bodyA->m_linearVelocity * timeOfImpact);
+	ab.Normalize();
+	contact.ptOnA_WorldSpace = bodyA->m_position + bodyA->m_linearVelocity * timeOfImpact + ab * sphereA->m_radius;
+	contact.ptOnB_WorldSpace = bodyB->m_position + bodyB->m_linearVelocity * timeOfImpact - ab * sphereB->m_radius;
+
+	// Convert world space contacts to local space
+	contact.ptOnA_LocalSpace = transformA.WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+	contact.ptOnB_LocalSpace = transformB.WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+
+	contact.normal = transformA.position - transformB.position;
+	contact.normal.Normalize();
+
+	// Calculate the separation distance
+	const Vec3 separation = bodyB->m_position - bodyA->m_position;
+	contact.separationDistance = separation.GetMagnitude() - (sphereA->m_radius + sphereB->m_radius);
+}
+
+// relative motions shorter than this only check whether the spheres already overlap
+static const float SPHERE_MIN_MOTION = 0.001f;
+// slack of that overlap check
+static const float SPHERE_STATIC_SLACK = 0.001f;
+
+#if defined( SIMD_AVX2_DISPATCH )
+/*
+====================================================
+FindContacts_SphereSphereBatch_AVX2
+
+The 8-wide part of FindContacts_SphereSphereBatch, built for AVX2 on its own.
+Tests the pairs eight at a time and returns the index of the first pair left over.
+====================================================
+*/
+static AVX2_TARGET int FindContacts_SphereSphereBatch_AVX2(const sphereSoA_t& pairs, const int count, const float dt, sphereContact_t* contacts, int& numContacts) {
+	const __m256 deltaTime = _mm256_set1_ps(dt);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 minMotionSquared = _mm256_set1_ps(SPHERE_MIN_MOTION * SPHERE_MIN_MOTION);
+	const __m256 staticSlack = _mm256_set1_ps(SPHERE_STATIC_SLACK);
+
+	int pairIndex = 0;
+	for (; pairIndex + 8 <= count; pairIndex += 8) {
+		const __m256 abX = _mm256_sub_ps(_mm256_loadu_ps(pairs.positionB[0] + pairIndex), _mm256_loadu_ps(pairs.positionA[0] + pairIndex));
+		const __m256 abY = _mm256_sub_ps(_mm256_loadu_ps(pairs.positionB[1] + pairIndex), _mm256_loadu_ps(pairs.positionA[1] + pairIndex));
+		const __m256 abZ = _mm256_sub_ps(_mm256_loadu_ps(pairs.positionB[2] + pairIndex), _mm256_loadu_ps(pairs.positionA[2] + pairIndex));
+		const __m256 rayX = _mm256_mul_ps(_mm256_loadu_ps(pairs.relativeVelocity[0] + pairIndex), deltaTime);
+		const __m256 rayY = _mm256_mul_ps(_mm256_loadu_ps(pairs.relativeVelocity[1] + pairIndex), deltaTime);
+		const __m256 rayZ = _mm256_mul_ps(_mm256_loadu_ps(pairs.relativeVelocity[2] + pairIndex), deltaTime);
+		const __m256 radiusSum = _mm256_loadu_ps(pairs.radiusSum + pairIndex);
+
+		const __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rayX, rayX), _mm256_mul_ps(rayY, rayY)), _mm256_mul_ps(rayZ, rayZ));
+		const __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(abX, rayX), _mm256_mul_ps(abY, rayY)), _mm256_mul_ps(abZ, rayZ));
+		const __m256 distanceSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(abX, abX), _mm256_mul_ps(abY, abY)), _mm256_mul_ps(abZ, abZ));
+		const __m256 c = _mm256_sub_ps(distanceSquared, _mm256_mul_ps(radiusSum, radiusSum));
+
+		// barely moving, touching now or not at all
+		const __m256 isStatic = _mm256_cmp_ps(a, minMotionSquared, _CMP_LT_OQ);
+		const __m256 staticReach = _mm256_add_ps(radiusSum, staticSlack);
+		const __m256 staticHit = _mm256_cmp_ps(distanceSquared, _mm256_mul_ps(staticReach, staticReach), _CMP_LE_OQ);
+
+		// moving, the earliest time in [0, dt] the ray is within the sum of the radii
+		const __m256 discriminantSquared = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+		const __m256 discriminant = _mm256_sqrt_ps(_mm256_max_ps(discriminantSquared, zero));
+		const __m256 invA = _mm256_div_ps(_mm256_set1_ps(1.0f), a);
+		const __m256 time1 = _mm256_mul_ps(_mm256_mul_ps(invA, _mm256_sub_ps(b, discriminant)), deltaTime);
+		const __m256 time2 = _mm256_mul_ps(_mm256_mul_ps(invA, _mm256_add_ps(b, discriminant)), deltaTime);
+		const __m256 rayTimeOfImpact = _mm256_max_ps(time1, zero);
+		__m256 rayHit = _mm256_cmp_ps(discriminantSquared, zero, _CMP_GE_OQ);
+		rayHit = _mm256_and_ps(rayHit, _mm256_cmp_ps(time2, zero, _CMP_GE_OQ));
+		rayHit = _mm256_and_ps(rayHit, _mm256_cmp_ps(rayTimeOfImpact, deltaTime, _CMP_LE_OQ));
+
+		const __m256 hit = _mm256_blendv_ps(rayHit, staticHit, isStatic);
+		const int hitMask = _mm256_movemask_ps(hit);
+		if (0 == hitMask)
+			continue;
+
+		float timesOfImpact[8];
+		_mm256_storeu_ps(timesOfImpact, _mm256_blendv_ps(rayTimeOfImpact, zero, isStatic));
+		for (int lane = 0; lane < 8; ++lane) {
+			if (hitMask & (1 << lane)) {
+				contacts[numContacts].pairIndex = pairIndex + lane;
+				contacts[numContacts].timeOfImpact = timesOfImpact[lane];
+				++numContacts;
+			}
+		}
+	}
+	return pairIndex;
+}
+#endif
+
+/*
+====================================================
+FindContacts_SphereSphereBatch
+
+The same test as DoesIntersect_SphereSphereDynamic, with both of its branches
+evaluated in every lane and the one that applies picked by mask:
+pairs that barely move only check the current overlap,
+the others cast the relative motion against the sum of the radii.
+Eight pairs per step when the CPU has AVX2, four with SSE, the remainder is scalar.
+====================================================
+*/
+int FindContacts_SphereSphereBatch(const sphereSoA_t& pairs, const int count, const float dt, sphereContact_t* contacts) {
+	int numContacts = 0;
+	int pairIndex = 0;
+
+#if defined( SIMD_AVX2_DISPATCH )
+	if (HasAVX2())
+		pairIndex = FindContacts_SphereSphereBatch_AVX2(pairs, count, dt, contacts, numContacts);
+#endif
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+	{
+		const __m128 deltaTime = _mm_set1_ps(dt);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 minMotionSquared = _mm_set1_ps(SPHERE_MIN_MOTION * SPHERE_MIN_MOTION);
+		const __m128 staticSlack = _mm_set1_ps(SPHERE_STATIC_SLACK);
+
+		for (; pairIndex + 4 <= count; pairIndex += 4) {
+			const __m128 abX = _mm_sub_ps(_mm_loadu_ps(pairs.positionB[0] + pairIndex), _mm_loadu_ps(pairs.positionA[0] + pairIndex));
+			const __m128 abY = _mm_sub_ps(_mm_loadu_ps(pairs.positionB[1] + pairIndex), _mm_loadu_ps(pairs.positionA[1] + pairIndex));
+			const __m128 abZ = _mm_sub_ps(_mm_loadu_ps(pairs.positionB[2] + pairIndex), _mm_loadu_ps(pairs.positionA[2] + pairIndex));
+			const __m128 rayX = _mm_mul_ps(_mm_loadu_ps(pairs.relativeVelocity[0] + pairIndex), deltaTime);
+			const __m128 rayY = _mm_mul_ps(_mm_loadu_ps(pairs.relativeVelocity[1] + pairIndex), deltaTime);
+			const __m128 rayZ = _mm_mul_ps(_mm_loadu_ps(pairs.relativeVelocity[2] + pairIndex), deltaTime);
+			const __m128 radiusSum = _mm_loadu_ps(pairs.radiusSum + pairIndex);
+
+			const __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rayX, rayX), _mm_mul_ps(rayY, rayY)), _mm_mul_ps(rayZ, rayZ));
+			const __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abX, rayX), _mm_mul_ps(abY, rayY)), _mm_mul_ps(abZ, rayZ));
+			const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abX, abX), _mm_mul_ps(abY, abY)), _mm_mul_ps(abZ, abZ));
+			const __m128 c = _mm_sub_ps(distanceSquared, _mm_mul_ps(radiusSum, radiusSum));
+
+			// barely moving, touching now or not at all
+			const __m128 isStatic = _mm_cmplt_ps(a, minMotionSquared);
+			const __m128 staticReach = _mm_add_ps(radiusSum, staticSlack);
+			const __m128 staticHit = _mm_cmple_ps(distanceSquared, _mm_mul_ps(staticReach, staticReach));
+
+			// moving, the earliest time in [0, dt] the ray is within the sum of the radii
+			const __m128 discriminantSquared = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+			const __m128 discriminant = _mm_sqrt_ps(_mm_max_ps(discriminantSquared, zero));
+			const __m128 invA = _mm_div_ps(_mm_set1_ps(1.0f), a);
+			const __m128 time1 = _mm_mul_ps(_mm_mul_ps(invA, _mm_sub_ps(b, discriminant)), deltaTime);
+			const __m128 time2 = _mm_mul_ps(_mm_mul_ps(invA, _mm_add_ps(b, discriminant)), deltaTime);
+			const __m128 rayTimeOfImpact = _mm_max_ps(time1, zero);
+			__m128 rayHit = _mm_cmpge_ps(discriminantSquared, zero);
+			rayHit = _mm_and_ps(rayHit, _mm_cmpge_ps(time2, zero));
+			rayHit = _mm_and_ps(rayHit, _mm_cmple_ps(rayTimeOfImpact, deltaTime));
+
+			// SSE2 has no blend, select with the masks
+			const __m128 hit = _mm_or_ps(_mm_and_ps(isStatic, staticHit), _mm_andnot_ps(isStatic, rayHit));
+			const int hitMask = _mm_movemask_ps(hit);
+			if (0 == hitMask)
+				continue;
+
+			float timesOfImpact[4];
+			_mm_storeu_ps(timesOfImpact, _mm_andnot_ps(isStatic, rayTimeOfImpact));
+			for (int lane = 0; lane < 4; ++lane) {
+				if (hitMask & (1 << lane)) {
+					contacts[numContacts].pairIndex = pairIndex + lane;
+					contacts[numContacts].timeOfImpact = timesOfImpact[lane];
+					++numContacts;
+				}
+			}
+		}
+	}
+#endif
+
+	for (; pairIndex < count; ++pairIndex) {
+		const Vec3 ab(pairs.positionB[0][pairIndex] - pairs.positionA[0][pairIndex], pairs.positionB[1][pairIndex] - pairs.positionA[1][pairIndex], pairs.positionB[2][pairIndex] - pairs.positionA[2][pairIndex]);
+		const Vec3 ray = Vec3(pairs.relativeVelocity[0][pairIndex], pairs.relativeVelocity[1][pairIndex], pairs.relativeVelocity[2][pairIndex]) * dt;
+		const float radiusSum = pairs.radiusSum[pairIndex];
+
+		float timeOfImpact = 0.0f;
+		const float a = ray.Dot(ray);
+		if (a < SPHERE_MIN_MOTION * SPHERE_MIN_MOTION) {
+			const float staticReach = radiusSum + SPHERE_STATIC_SLACK;
+			if (ab.GetLengthSqr() > staticReach * staticReach)
+				continue;
+		}
+		else {
+			const float b = ab.Dot(ray);
+			const float c = ab.Dot(ab) - radiusSum * radiusSum;
+			const float discriminantSquared = b * b - a * c;
+			if (discriminantSquared < 0.0f)
+				continue;
+
+			const float discriminant = sqrtf(discriminantSquared);
+			const float invA = 1.0f / a;
+			const float time1 = invA * (b - discriminant) * dt;
+			const float time2 = invA * (b + discriminant) * dt;
+			timeOfImpact = (time1 < 0.0f) ? 0.0f : time1;
+			if (time2 < 0.0f || timeOfImpact > dt)
+				continue;
+		}
+
+		contacts[numContacts].pairIndex = pairIndex;
+		contacts[numContacts].timeOfImpact = timeOfImpact;
+		++numContacts;
+	}
+	return numContacts;
+}
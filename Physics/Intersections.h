@@ -4,8 +4,42 @@
 #pragma once
 #include "Contact.h"
 
+struct gjkCache_t;
+
 bool DoesHit_RaySphere(const Vec3& rayStart, const Vec3& rayDirection, const Vec3& sphereCenter, const float sphereRadius, float& time1, float& time2);
 bool DoesIntersect_SphereSphereDynamic(const ShapeSphere* shapeA, const ShapeSphere* shapeB, const Vec3& positionA, const Vec3& positionB, const Vec3& velocityA, const Vec3& velocityB,
 						 const float deltaTime, Vec3& pointOnA, Vec3& pointOnB, float& timeOfImpact);
 bool DoesIntersect( Body * bodyA, Body * bodyB, contact_t & contact );
-bool DoesIntersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact );
+bool DoesIntersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact, gjkCache_t * cache = nullptr );
+
+// DoesIntersect with a time step, except that touching pairs with a manifold function (box-box)
+// return all of their contact points at once. Returns the number of contacts written.
+// The GJK cache of the pair is optional, see gjkCache_t.
+int FindContacts( Body * bodyA, Body * bodyB, const float dt, contact_t contacts[ MAX_MANIFOLD_CONTACTS ], gjkCache_t * cache = nullptr );
+
+/*
+====================================================
+sphereSoA_t
+
+Sphere pairs stored as one array per component, for FindContacts_SphereSphereBatch
+====================================================
+*/
+struct sphereSoA_t {
+	const float * positionA[ 3 ];
+	const float * positionB[ 3 ];
+	const float * relativeVelocity[ 3 ];	// velocity of A minus velocity of B
+	const float * radiusSum;
+};
+
+// compact result of FindContacts_SphereSphereBatch, GetContact_SphereSphere fills in the rest
+struct sphereContact_t {
+	int pairIndex;		// into the batch
+	float timeOfImpact;
+};
+
+// DoesIntersect for sphere pairs [0, count), eight per step with AVX2, four with SSE, the remainder scalar.
+// Writes one record per pair that touches within dt to contacts (room for count entries), returns the number of them.
+int FindContacts_SphereSphereBatch( const sphereSoA_t & pairs, const int count, const float dt, sphereContact_t * contacts );
+
+// the contact DoesIntersect reports for two spheres that touch at timeOfImpact
+void GetContact_SphereSphere( Body * bodyA, Body * bodyB, const float timeOfImpact, contact_t & contact );
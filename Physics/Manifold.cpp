@@ -58,6 +58,33 @@ void ManifoldCollector::RemoveExpired() {
 	}
 }
 
+/*
+================================
+ManifoldCollector::RemovePairs
+
+Drops the manifolds of the pairs the broadphase reported as ended,
+their bounds are apart so none of their contacts can still be touching.
+================================
+*/
+void ManifoldCollector::RemovePairs(const Body* bodies, const std::vector<collisionPair_t>& endedPairs) {
+	if (endedPairs.empty() || m_manifolds.empty())
+		return;
+
+	std::vector<uint64_t> endedKeys;
+	endedKeys.reserve(endedPairs.size());
+	for (const collisionPair_t& currentPair : endedPairs)
+		endedKeys.push_back(currentPair.GetKey());
+	std::sort(endedKeys.begin(), endedKeys.end());
+
+	// One pass that keeps the order of the surviving manifolds, the solver order stays the same
+	auto isEnded = [&](const Manifold& currentManifold) {
+		const int bodyA = static_cast<int>(currentManifold.m_bodyA - bodies);
+		const int bodyB = static_cast<int>(currentManifold.m_bodyB - bodies);
+		return std::binary_search(endedKeys.begin(), endedKeys.end(), collisionPair_t::GetKey(bodyA, bodyB));
+	};
+	m_manifolds.erase(std::remove_if(m_manifolds.begin(), m_manifolds.end(), isEnded), m_manifolds.end());
+}
+
 /*
 ================================
 ManifoldCollector::PreSolve
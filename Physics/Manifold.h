@@ -5,6 +5,7 @@
 #include "Body.h"
 #include "Constraints.h"
 #include "Contact.h"
+#include "Broadphase.h"
 
 /*
 ================================
@@ -54,6 +55,7 @@ public:
 	void PostSolve();
 
 	void RemoveExpired();
+	void RemovePairs( const Body * bodies, const std::vector< collisionPair_t > & endedPairs );
 	void Clear() { m_manifolds.clear(); }	// For resetting the demo
 
 public:
@@ -0,0 +1,170 @@
+//
+//  Midphase.cpp
+//
+#include "PCH.h"
+#include "Midphase.h"
+#include "ThreadPool.h"
+
+// Kept well above the contact bias of the narrowphase, so a pair it would report is never rejected
+static const float MIDPHASE_TOLERANCE = 0.01f;
+
+/*
+====================================================
+MidPhaseBuffer::Update
+====================================================
+*/
+void MidPhaseBuffer::Update(const Body* bodies, const int numBodies, ThreadPool* threadPool) {
+	m_bodies.resize(numBodies);
+
+	auto updateBodies = [&](const int begin, const int end, const int threadIndex) {
+		for (int bodyId = begin; bodyId < end; ++bodyId) {
+			const Body& body = bodies[bodyId];
+			const Shape* shape = body.m_shape;
+			midphaseBody_t& entry = m_bodies[bodyId];
+
+			const Bounds bounds = shape->GetBounds();
+			const Mat3 orientation = body.m_orientation.ToMat3();
+			entry.obb.center = body.m_position + body.m_orientation.RotatePoint((bounds.mins + bounds.maxs) * 0.5f);
+			for (int axis = 0; axis < 3; ++axis)
+				entry.obb.axes[axis] = orientation.rows[axis];
+			entry.obb.halfExtents = (bounds.maxs - bounds.mins) * 0.5f;
+
+			entry.centerOfMass = body.GetCenterOfMassWorldSpace();
+			entry.linearVelocity = body.m_linearVelocity;
+			entry.boundingRadius = shape->GetBoundingRadius();
+			entry.angularReach = body.m_angularVelocity.GetMagnitude() * entry.boundingRadius;
+			entry.isSphere = (Shape::SHAPE_SPHERE == shape->GetType());
+		}
+	};
+	if (nullptr != threadPool)
+		threadPool->ParallelFor(numBodies, BODIES_PER_CHUNK, updateBodies);
+	else
+		updateBodies(0, numBodies, 0);
+}
+
+/*
+====================================================
+GetMotionBound
+
+How much closer any point of A can get to any point of B within deltaSecond.
+The relative linear velocity moves every point alike, the spins move a point
+by at most the angle times its distance to the center of mass.
+====================================================
+*/
+static float GetMotionBound(const midphaseBody_t& bodyA, const midphaseBody_t& bodyB, const float deltaSecond) {
+	const float linearSpeed = (bodyB.linearVelocity - bodyA.linearVelocity).GetMagnitude();
+	return (linearSpeed + bodyA.angularReach + bodyB.angularReach) * deltaSecond;
+}
+
+/*
+====================================================
+GetMidPhaseMargin
+====================================================
+*/
+float GetMidPhaseMargin(const MidPhaseBuffer& buffer, const int bodyIdA, const int bodyIdB, const float deltaSecond) {
+	return GetMotionBound(buffer.GetBody(bodyIdA), buffer.GetBody(bodyIdB), deltaSecond) + MIDPHASE_TOLERANCE;
+}
+
+/*
+====================================================
+IsSeparated_SphereOBB
+====================================================
+*/
+static bool IsSeparated_SphereOBB(const Vec3& sphereCenter, const float sphereRadius, const obb_t& obb, const float margin) {
+	const Vec3 offset = sphereCenter - obb.center;
+	float distanceSquared = 0.0f;
+	for (int axis = 0; axis < 3; ++axis) {
+		const float outside = fabsf(offset.Dot(obb.axes[axis])) - obb.halfExtents[axis];
+		if (outside > 0.0f)
+			distanceSquared += outside * outside;
+	}
+
+	const float reach = sphereRadius + margin;
+	return distanceSquared > reach * reach;
+}
+
+/*
+====================================================
+IsSeparated_OBBOBB
+
+The 15 axes of the separating axis test for two boxes, in the frame of A.
+The edge axes are not normalized, their length is at most one,
+so adding the full margin to them only makes the test more conservative.
+====================================================
+*/
+static bool IsSeparated_OBBOBB(const obb_t& obbA, const obb_t& obbB, const float margin) {
+	// Keeps the edge axes of nearly parallel edges from passing as separating
+	const float PARALLEL_EPSILON = 1e-5f;
+
+	float rotation[3][3];
+	float absRotation[3][3];
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			rotation[i][j] = obbA.axes[i].Dot(obbB.axes[j]);
+			absRotation[i][j] = fabsf(rotation[i][j]) + PARALLEL_EPSILON;
+		}
+	}
+
+	const Vec3 offsetWorld = obbB.center - obbA.center;
+	const Vec3 offset(offsetWorld.Dot(obbA.axes[0]), offsetWorld.Dot(obbA.axes[1]), offsetWorld.Dot(obbA.axes[2]));
+	const Vec3& a = obbA.halfExtents;
+	const Vec3& b = obbB.halfExtents;
+
+	// Face axes of A
+	for (int i = 0; i < 3; ++i) {
+		const float radiusB = b[0] * absRotation[i][0] + b[1] * absRotation[i][1] + b[2] * absRotation[i][2];
+		if (fabsf(offset[i]) > a[i] + radiusB + margin)
+			return true;
+	}
+
+	// Face axes of B
+	for (int j = 0; j < 3; ++j) {
+		const float radiusA = a[0] * absRotation[0][j] + a[1] * absRotation[1][j] + a[2] * absRotation[2][j];
+		const float distance = offset[0] * rotation[0][j] + offset[1] * rotation[1][j] + offset[2] * rotation[2][j];
+		if (fabsf(distance) > radiusA + b[j] + margin)
+			return true;
+	}
+
+	// Edge axes, A's axis i crossed with B's axis j
+	for (int i = 0; i < 3; ++i) {
+		const int i1 = (i + 1) % 3;
+		const int i2 = (i + 2) % 3;
+		for (int j = 0; j < 3; ++j) {
+			const int j1 = (j + 1) % 3;
+			const int j2 = (j + 2) % 3;
+			const float radiusA = a[i1] * absRotation[i2][j] + a[i2] * absRotation[i1][j];
+			const float radiusB = b[j1] * absRotation[i][j2] + b[j2] * absRotation[i][j1];
+			const float distance = offset[i2] * rotation[i1][j] - offset[i1] * rotation[i2][j];
+			if (fabsf(distance) > radiusA + radiusB + margin)
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+====================================================
+MayIntersect
+====================================================
+*/
+bool MayIntersect(const MidPhaseBuffer& buffer, const int bodyIdA, const int bodyIdB, const float deltaSecond) {
+	const midphaseBody_t& bodyA = buffer.GetBody(bodyIdA);
+	const midphaseBody_t& bodyB = buffer.GetBody(bodyIdB);
+	const float margin = GetMidPhaseMargin(buffer, bodyIdA, bodyIdB, deltaSecond);
+
+	// Bounding spheres around the centers of mass
+	const float reach = bodyA.boundingRadius + bodyB.boundingRadius + margin;
+	if ((bodyB.centerOfMass - bodyA.centerOfMass).GetLengthSqr() > reach * reach)
+		return false;
+
+	// Two spheres are their bounding spheres
+	if (bodyA.isSphere && bodyB.isSphere)
+		return true;
+
+	if (bodyA.isSphere)
+		return !IsSeparated_SphereOBB(bodyA.centerOfMass, bodyA.boundingRadius, bodyB.obb, margin);
+	if (bodyB.isSphere)
+		return !IsSeparated_SphereOBB(bodyB.centerOfMass, bodyB.boundingRadius, bodyA.obb, margin);
+
+	return !IsSeparated_OBBOBB(bodyA.obb, bodyB.obb, margin);
+}
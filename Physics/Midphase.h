@@ -0,0 +1,61 @@
+//
+//	Midphase.h
+//
+#pragma once
+#include "Body.h"
+
+class ThreadPool;
+
+/*
+====================================================
+obb_t
+
+The body space bounds of a shape, placed in the world
+====================================================
+*/
+struct obb_t {
+	Vec3 center;
+	Vec3 axes[ 3 ];
+	Vec3 halfExtents;
+};
+
+// What the mid-phase needs of a body, in world space
+struct midphaseBody_t {
+	obb_t obb;				// the body space bounds of the shape, placed in the world
+	Vec3 centerOfMass;
+	Vec3 linearVelocity;
+	float boundingRadius;	// around the center of mass
+	float angularReach;		// how fast the spin moves the point furthest from the center of mass
+	bool isSphere;
+};
+
+/*
+====================================================
+MidPhaseBuffer
+
+The mid-phase data of every body for one step. Each body's shape bounds, radius and
+orientation are read once per step, so the per pair test calls no virtual shape functions.
+====================================================
+*/
+class MidPhaseBuffer {
+public:
+	void Update( const Body * bodies, const int numBodies, ThreadPool * threadPool = nullptr );
+	void Clear() { m_bodies.clear(); }
+
+	const midphaseBody_t & GetBody( const int bodyId ) const { return m_bodies[ bodyId ]; }
+
+private:
+	std::vector< midphaseBody_t > m_bodies;
+
+	static const int BODIES_PER_CHUNK = 256;
+};
+
+// Cheap test between the broadphase and the narrowphase. The broadphase pairs only overlap as
+// world aligned boxes, which says little about rotated boxes and hulls. This tests the bounding spheres,
+// then the oriented boxes of the shapes (their body space bounds) with the separating axis test,
+// every bound grown by how far the bodies can move towards each other within deltaSecond.
+// Returns false only when the bodies cannot touch in this step, so the pair can skip FindContacts.
+bool MayIntersect( const MidPhaseBuffer & buffer, const int bodyIdA, const int bodyIdB, const float deltaSecond );
+
+// shapes further apart than this can not touch within deltaSecond, the bounds of MayIntersect are grown by it
+float GetMidPhaseMargin( const MidPhaseBuffer & buffer, const int bodyIdA, const int bodyIdB, const float deltaSecond );
@@ -0,0 +1,332 @@
+//
+//  Narrowphase.cpp
+//
+#include "PCH.h"
+#include "Narrowphase.h"
+#include "Intersections.h"
+#include "Midphase.h"
+
+const float NarrowPhaseContext::RESTING_TOLERANCE = 0.001f;
+
+/*
+====================================================
+GetRelativePose
+
+Center of mass and orientation of B in the body space of A
+====================================================
+*/
+static void GetRelativePose(const Body* bodyA, const Body* bodyB, Vec3& relativePosition, Quat& relativeOrientation) {
+	const Quat inverseOrientationA = bodyA->m_orientation.Inverse();
+	relativePosition = inverseOrientationA.RotatePoint(bodyB->GetCenterOfMassWorldSpace() - bodyA->GetCenterOfMassWorldSpace());
+	relativeOrientation = inverseOrientationA * bodyB->m_orientation;
+}
+
+/*
+====================================================
+ReuseContacts
+
+The contacts of the cache moved to the current poses when the pair is still resting
+the way it was when they were found, 0 otherwise.
+A rotation by the angle t moves the points of B by at most t times its bounding radius,
+and the vector part of the rotation between the two orientations has the length sin( t / 2 ).
+====================================================
+*/
+static int ReuseContacts(const contactCache_t& cache, Body* bodyA, Body* bodyB, contact_t contacts[MAX_MANIFOLD_CONTACTS]) {
+	if (0 == cache.numContacts || cache.contacts[0].bodyA != bodyA || cache.contacts[0].bodyB != bodyB)
+		return 0;
+
+	Vec3 relativePosition;
+	Quat relativeOrientation;
+	GetRelativePose(bodyA, bodyB, relativePosition, relativeOrientation);
+
+	const float translation = (relativePosition - cache.relativePosition).GetMagnitude();
+	const Quat rotation = cache.relativeOrientation.Inverse() * relativeOrientation;
+	const float rotationDistance = 2.0f * rotation.xyz().GetMagnitude() * bodyB->m_shape->GetBoundingRadius();
+	if (translation + rotationDistance > NarrowPhaseContext::RESTING_TOLERANCE)
+		return 0;
+
+	for (int contactIndex = 0; contactIndex < cache.numContacts; ++contactIndex) {
+		contact_t& contact = contacts[contactIndex];
+		contact = cache.contacts[contactIndex];
+		contact.ptOnA_WorldSpace = bodyA->BodySpaceToWorldSpace(contact.ptOnA_LocalSpace);
+		contact.ptOnB_WorldSpace = bodyB->BodySpaceToWorldSpace(contact.ptOnB_LocalSpace);
+		contact.normal = bodyA->m_orientation.RotatePoint(contact.normal);
+		contact.separationDistance = (contact.ptOnA_WorldSpace - contact.ptOnB_WorldSpace).Dot(contact.normal);
+	}
+	return cache.numContacts;
+}
+
+/*
+====================================================
+StoreContacts
+
+Keeps the result of a full query for ReuseContacts, as long as all of its contacts are touching
+====================================================
+*/
+static void StoreContacts(contactCache_t& cache, const Body* bodyA, const Body* bodyB, const contact_t* contacts, const int numContacts) {
+	cache.numContacts = 0;
+	for (int contactIndex = 0; contactIndex < numContacts; ++contactIndex) {
+		if (0.0f != contacts[contactIndex].timeOfImpact)
+			return;
+	}
+
+	GetRelativePose(bodyA, bodyB, cache.relativePosition, cache.relativeOrientation);
+	const Quat inverseOrientationA = bodyA->m_orientation.Inverse();
+	for (int contactIndex = 0; contactIndex < numContacts; ++contactIndex) {
+		cache.contacts[contactIndex] = contacts[contactIndex];
+		cache.contacts[contactIndex].normal = inverseOrientationA.RotatePoint(contacts[contactIndex].normal);
+	}
+	cache.numContacts = numContacts;
+}
+
+/*
+====================================================
+sphereBatch_t
+
+The sphere-sphere pairs of one chunk, gathered for FindContacts_SphereSphereBatch
+====================================================
+*/
+struct sphereBatch_t {
+	static const int MAX_PAIRS = NarrowPhaseContext::PAIRS_PER_CHUNK;
+
+	float positionA[3][MAX_PAIRS];
+	float positionB[3][MAX_PAIRS];
+	float relativeVelocity[3][MAX_PAIRS];
+	float radiusSum[MAX_PAIRS];
+	int pairIndices[MAX_PAIRS];	// into the pair list
+	int count;
+
+	static bool IsSpherePair(const Body* bodyA, const Body* bodyB) {
+		return Shape::SHAPE_SPHERE == bodyA->m_shape->GetType() && Shape::SHAPE_SPHERE == bodyB->m_shape->GetType();
+	}
+
+	void Add(const int pairIndex, const Body* bodyA, const Body* bodyB) {
+		const Vec3 velocity = bodyA->m_linearVelocity - bodyB->m_linearVelocity;
+		for (int axis = 0; axis < 3; ++axis) {
+			positionA[axis][count] = bodyA->m_position[axis];
+			positionB[axis][count] = bodyB->m_position[axis];
+			relativeVelocity[axis][count] = velocity[axis];
+		}
+		radiusSum[count] = ((const ShapeSphere*)bodyA->m_shape)->m_radius + ((const ShapeSphere*)bodyB->m_shape)->m_radius;
+		pairIndices[count] = pairIndex;
+		++count;
+	}
+
+	sphereSoA_t GetSoA() const {
+		sphereSoA_t soa;
+		for (int axis = 0; axis < 3; ++axis) {
+			soa.positionA[axis] = positionA[axis];
+			soa.positionB[axis] = positionB[axis];
+			soa.relativeVelocity[axis] = relativeVelocity[axis];
+		}
+		soa.radiusSum = radiusSum;
+		return soa;
+	}
+};
+
+/*
+====================================================
+NarrowPhase
+
+Runs FindContacts on every pair that has a dynamic body and passes the mid-phase test,
+with the GJK cache of the pair. Resting pairs reuse the contacts of their last query instead.
+Sphere-sphere pairs skip all of that, every chunk tests them together with FindContacts_SphereSphereBatch.
+Convex pairs that were apart last step take the mid-phase before the chunks, and the ones it lets through
+take AreSeparated_GJKBatch with the mid-phase margin. Pairs it proves apart can not touch in this step.
+Contacts that are already touching (zero time of impact) go to staticContacts,
+the rest go to dynamicContacts, both in the order of the pair list.
+====================================================
+*/
+void NarrowPhase(NarrowPhaseContext& context, Body* bodies, const int numBodies, const std::vector<collisionPair_t>& pairs, const float deltaSecond,
+				 std::vector<contact_t>& staticContacts, std::vector<contact_t>& dynamicContacts) {
+	const int numPairs = static_cast<int>(pairs.size());
+	const int numThreads = context.m_threadPool.GetNumThreads();
+	const int chunkSize = NarrowPhaseContext::PAIRS_PER_CHUNK;
+
+	context.m_threadContacts.resize(numThreads);
+	for (std::vector<contact_t>& threadContacts : context.m_threadContacts)
+		threadContacts.clear();
+	context.m_chunks.resize((numPairs + chunkSize - 1) / chunkSize);
+	context.UpdateMidPhase(bodies, numBodies);
+
+	// Look the caches up before going wide, the threads then only touch the cache of their own pairs
+	context.m_pairCaches.resize(numPairs);
+	for (int pairIndex = 0; pairIndex < numPairs; ++pairIndex)
+		context.m_pairCaches[pairIndex] = &context.m_caches[pairs[pairIndex].GetKey()];
+
+	// Convex pairs with no contacts to reuse take the mid-phase here, the ones it lets through go on to the batch
+	context.m_pairStates.resize(numPairs);
+	auto checkPairs = [&](const int begin, const int end, const int threadIndex) {
+		for (int pairIndex = begin; pairIndex < end; ++pairIndex) {
+			const Body* bodyA = &bodies[pairs[pairIndex].a];
+			const Body* bodyB = &bodies[pairs[pairIndex].b];
+			NarrowPhaseContext::pairState_t& state = context.m_pairStates[pairIndex];
+			state = NarrowPhaseContext::PAIR_UNCHECKED;
+			if (0.0f == bodyA->m_invMass && 0.0f == bodyB->m_invMass)
+				continue;
+			if (Shape::SHAPE_CONVEX != bodyA->m_shape->GetType() || Shape::SHAPE_CONVEX != bodyB->m_shape->GetType())
+				continue;
+			if (0 != context.m_pairCaches[pairIndex]->contacts.numContacts)
+				continue;
+
+			state = MayIntersect(context.m_midPhase, pairs[pairIndex].a, pairs[pairIndex].b, deltaSecond) ? NarrowPhaseContext::PAIR_MAY_INTERSECT : NarrowPhaseContext::PAIR_SEPARATED;
+		}
+	};
+	context.m_threadPool.ParallelFor(numPairs, chunkSize, checkPairs);
+
+	context.m_convexPairs.clear();
+	context.m_convexPairIndices.clear();
+	for (int pairIndex = 0; pairIndex < numPairs; ++pairIndex) {
+		if (NarrowPhaseContext::PAIR_MAY_INTERSECT != context.m_pairStates[pairIndex])
+			continue;
+
+		const collisionPair_t& pair = pairs[pairIndex];
+		gjkBatchPair_t convexPair;
+		convexPair.bodyA = &bodies[pair.a];
+		convexPair.bodyB = &bodies[pair.b];
+		convexPair.minDistance = GetMidPhaseMargin(context.m_midPhase, pair.a, pair.b, deltaSecond);
+		convexPair.cache = &context.m_pairCaches[pairIndex]->gjk;
+		convexPair.isSeparated = false;
+		context.m_convexPairs.push_back(convexPair);
+		context.m_convexPairIndices.push_back(pairIndex);
+	}
+
+	auto separatePairs = [&](const int begin, const int end, const int threadIndex) {
+		AreSeparated_GJKBatch(context.m_convexPairs.data() + begin, end - begin);
+		for (int convexIndex = begin; convexIndex < end; ++convexIndex) {
+			if (context.m_convexPairs[convexIndex].isSeparated)
+				context.m_pairStates[context.m_convexPairIndices[convexIndex]] = NarrowPhaseContext::PAIR_SEPARATED;
+		}
+	};
+	context.m_threadPool.ParallelFor(static_cast<int>(context.m_convexPairs.size()), NarrowPhaseContext::CONVEX_PAIRS_PER_TASK, separatePairs);
+
+	auto findContacts = [&](const int begin, const int end, const int threadIndex) {
+		std::vector<contact_t>& threadContacts = context.m_threadContacts[threadIndex];
+		NarrowPhaseContext::chunk_t& chunk = context.m_chunks[begin / chunkSize];
+		chunk.threadIndex = threadIndex;
+		chunk.firstContact = static_cast<int>(threadContacts.size());
+		chunk.numRejectedPairs = 0;
+		chunk.numReusedPairs = 0;
+
+		sphereBatch_t sphereBatch;
+		sphereBatch.count = 0;
+		for (int pairIndex = begin; pairIndex < end; ++pairIndex) {
+			const Body* bodyA = &bodies[pairs[pairIndex].a];
+			const Body* bodyB = &bodies[pairs[pairIndex].b];
+			if ((0.0f != bodyA->m_invMass || 0.0f != bodyB->m_invMass) && sphereBatch_t::IsSpherePair(bodyA, bodyB))
+				sphereBatch.Add(pairIndex, bodyA, bodyB);
+		}
+		sphereContact_t sphereContacts[sphereBatch_t::MAX_PAIRS];
+		const int numSphereContacts = FindContacts_SphereSphereBatch(sphereBatch.GetSoA(), sphereBatch.count, deltaSecond, sphereContacts);
+		int nextSpherePair = 0;
+		int nextSphereContact = 0;
+
+		for (int pairIndex = begin; pairIndex < end; ++pairIndex) {
+			Body* bodyA = &bodies[pairs[pairIndex].a];
+			Body* bodyB = &bodies[pairs[pairIndex].b];
+
+			if (0.0f == bodyA->m_invMass && 0.0f == bodyB->m_invMass)
+				continue;
+
+			// the batch holds the sphere pairs in pair order, and its contacts in batch order
+			if (nextSpherePair < sphereBatch.count && sphereBatch.pairIndices[nextSpherePair] == pairIndex) {
+				if (nextSphereContact < numSphereContacts && sphereContacts[nextSphereContact].pairIndex == nextSpherePair) {
+					contact_t contact;
+					GetContact_SphereSphere(bodyA, bodyB, sphereContacts[nextSphereContact].timeOfImpact, contact);
+					threadContacts.push_back(contact);
+					++nextSphereContact;
+				}
+				++nextSpherePair;
+				continue;
+			}
+
+			pairCache_t& cache = *context.m_pairCaches[pairIndex];
+			const NarrowPhaseContext::pairState_t state = context.m_pairStates[pairIndex];
+			if (NarrowPhaseContext::PAIR_SEPARATED == state) {
+				++chunk.numRejectedPairs;
+				continue;
+			}
+
+			contact_t pairContacts[MAX_MANIFOLD_CONTACTS];
+			int numContacts = ReuseContacts(cache.contacts, bodyA, bodyB, pairContacts);
+			if (numContacts > 0) {
+				++chunk.numReusedPairs;
+			}
+			else {
+				// the broadphase bounds overlap, most of the time the shapes themselves are nowhere near
+				if (NarrowPhaseContext::PAIR_UNCHECKED == state && !MayIntersect(context.m_midPhase, pairs[pairIndex].a, pairs[pairIndex].b, deltaSecond)) {
+					cache.contacts.numContacts = 0;
+					++chunk.numRejectedPairs;
+					continue;
+				}
+
+				// the queries only read the bodies, so pairs that share a body can run on different threads
+				numContacts = FindContacts(bodyA, bodyB, deltaSecond, pairContacts, &cache.gjk);
+				StoreContacts(cache.contacts, bodyA, bodyB, pairContacts, numContacts);
+			}
+			for (int contactIndex = 0; contactIndex < numContacts; ++contactIndex)
+				threadContacts.push_back(pairContacts[contactIndex]);
+		}
+		chunk.numContacts = static_cast<int>(threadContacts.size()) - chunk.firstContact;
+	};
+	context.m_threadPool.ParallelFor(numPairs, chunkSize, findContacts);
+
+	// Merge in pair order
+	context.m_numRejectedPairs = 0;
+	context.m_numReusedPairs = 0;
+	for (const NarrowPhaseContext::chunk_t& chunk : context.m_chunks) {
+		context.m_numRejectedPairs += chunk.numRejectedPairs;
+		context.m_numReusedPairs += chunk.numReusedPairs;
+		const contact_t* chunkContacts = context.m_threadContacts[chunk.threadIndex].data() + chunk.firstContact;
+		for (int contactIndex = 0; contactIndex < chunk.numContacts; ++contactIndex) {
+			const contact_t& contact = chunkContacts[contactIndex];
+			if (0.0f == contact.timeOfImpact)
+				staticContacts.push_back(contact);
+			else
+				dynamicContacts.push_back(contact);
+		}
+	}
+}
+
+/*
+====================================================
+FindContacts_Cached
+====================================================
+*/
+int FindContacts_Cached(NarrowPhaseContext& context, const collisionPair_t& pair, Body* bodies, const float deltaSecond,
+						contact_t contacts[MAX_MANIFOLD_CONTACTS]) {
+	Body* bodyA = &bodies[pair.a];
+	Body* bodyB = &bodies[pair.b];
+	const uint64_t key = pair.GetKey();
+
+	auto it = context.m_caches.find(key);
+	if (it != context.m_caches.end()) {
+		const int numContacts = ReuseContacts(it->second.contacts, bodyA, bodyB, contacts);
+		if (numContacts > 0) {
+			++context.m_numReusedPairs;
+			return numContacts;
+		}
+	}
+
+	if (!MayIntersect(context.m_midPhase, pair.a, pair.b, deltaSecond)) {
+		if (it != context.m_caches.end())
+			context.m_caches.erase(it);
+		++context.m_numRejectedPairs;
+		return 0;
+	}
+
+	pairCache_t& cache = (it != context.m_caches.end()) ? it->second : context.m_caches[key];
+	const int numContacts = FindContacts(bodyA, bodyB, deltaSecond, contacts, &cache.gjk);
+	StoreContacts(cache.contacts, bodyA, bodyB, contacts, numContacts);
+	return numContacts;
+}
+
+/*
+====================================================
+NarrowPhaseContext::RemovePairs
+====================================================
+*/
+void NarrowPhaseContext::RemovePairs(const std::vector<collisionPair_t>& endedPairs) {
+	for (const collisionPair_t& currentPair : endedPairs)
+		m_caches.erase(currentPair.GetKey());
+}
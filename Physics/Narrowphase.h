@@ -0,0 +1,123 @@
+//
+//	Narrowphase.h
+//
+#pragma once
+#include "Contact.h"
+#include "Broadphase.h"
+#include "ThreadPool.h"
+#include "GJK.h"
+#include "Midphase.h"
+
+/*
+====================================================
+contactCache_t
+
+The contacts a pair found at the last full query, with the pose of B relative to A they were found at.
+As long as the relative pose stays within a tolerance of it, the pair is resting and the contacts
+are carried over instead of being searched for again. Only touching results (zero time of impact)
+are kept, those depend on the poses alone.
+====================================================
+*/
+struct contactCache_t {
+	contactCache_t() : numContacts( 0 ) {}
+
+	Vec3 relativePosition;		// center of mass of B in the body space of A
+	Quat relativeOrientation;	// orientation of B in the body space of A
+	int numContacts;			// 0 when there is nothing to reuse
+	contact_t contacts[ MAX_MANIFOLD_CONTACTS ];	// the normals in the body space of A
+};
+
+// everything the narrowphase keeps for one pair between steps
+struct pairCache_t {
+	gjkCache_t gjk;
+	contactCache_t contacts;
+};
+
+/*
+====================================================
+NarrowPhaseContext
+
+Everything the parallel narrowphase keeps between steps.
+Every thread writes its contacts to its own buffer, and every chunk of pairs
+remembers where its contacts landed, so the merge walks the chunks in pair order
+and the result does not depend on which thread ran which chunk.
+The pair caches live as long as the broadphase keeps reporting their pair.
+The mid-phase data of the bodies is gathered once per step, before the pairs are tested.
+Convex pairs that were apart last step are tested ahead of the chunks, the ones that pass the mid-phase
+go through AreSeparated_GJKBatch together so its lanes stay full across the whole pair list.
+====================================================
+*/
+class NarrowPhaseContext {
+public:
+	NarrowPhaseContext() : m_numRejectedPairs( 0 ), m_numReusedPairs( 0 ) {}
+
+	void Clear() {
+		m_threadContacts.clear();
+		m_chunks.clear();
+		m_midPhase.Clear();
+		m_pairStates.clear();
+		m_convexPairs.clear();
+		m_convexPairIndices.clear();
+		ClearCaches();
+		m_numRejectedPairs = 0;
+		m_numReusedPairs = 0;
+	}
+	void ClearCaches() {
+		m_caches.clear();
+		m_pairCaches.clear();
+	}
+
+	void RemovePairs( const std::vector< collisionPair_t > & endedPairs );
+
+	// NarrowPhase does this itself, loops over FindContacts_Cached call it once per step first
+	void UpdateMidPhase( const Body * bodies, const int numBodies ) { m_midPhase.Update( bodies, numBodies, &m_threadPool ); }
+
+	struct chunk_t {
+		int threadIndex;
+		int firstContact;
+		int numContacts;
+		int numRejectedPairs;
+		int numReusedPairs;
+	};
+
+	// what the tests ahead of the chunks found out about a pair
+	enum pairState_t : uint8_t {
+		PAIR_UNCHECKED,		// left to the chunk
+		PAIR_MAY_INTERSECT,	// passed the mid-phase
+		PAIR_SEPARATED		// rejected by the mid-phase or proven apart by AreSeparated_GJKBatch
+	};
+
+	ThreadPool m_threadPool;
+
+	MidPhaseBuffer m_midPhase;
+
+	std::vector< std::vector< contact_t > > m_threadContacts;
+	std::vector< chunk_t > m_chunks;
+
+	// pair key -> cache, the nodes of the map stay put so the pair list can point into it
+	std::unordered_map< uint64_t, pairCache_t > m_caches;
+	std::vector< pairCache_t * > m_pairCaches;	// one per pair of the current step
+	std::vector< pairState_t > m_pairStates;	// one per pair of the current step
+
+	// the convex pairs of the step that go through AreSeparated_GJKBatch, and where they are in the pair list
+	std::vector< gjkBatchPair_t > m_convexPairs;
+	std::vector< int > m_convexPairIndices;
+
+	int m_numRejectedPairs;	// pairs of the last step that the mid-phase or the batched GJK kept from FindContacts
+	int m_numReusedPairs;	// resting pairs of the last step that reused their contacts
+
+	static const float RESTING_TOLERANCE;	// how far any point of B may have moved relative to A for the contacts to be reused
+
+	static const int PAIRS_PER_CHUNK = 32;
+	static const int CONVEX_PAIRS_PER_TASK = 64;	// pairs per AreSeparated_GJKBatch call
+};
+
+void NarrowPhase( NarrowPhaseContext & context, Body * bodies, const int numBodies, const std::vector< collisionPair_t > & pairs, const float deltaSecond,
+				  std::vector< contact_t > & staticContacts, std::vector< contact_t > & dynamicContacts );
+
+// One pair on the calling thread, the way NarrowPhase runs it: a resting pair reuses its contacts,
+// any other pair goes through the mid-phase and then FindContacts with the GJK cache of the pair.
+// The cache of a rejected pair is dropped, so loops without broadphase events do not pile them up.
+// Reads the mid-phase data of the step, see NarrowPhaseContext::UpdateMidPhase.
+int FindContacts_Cached( NarrowPhaseContext & context, const collisionPair_t & pair, Body * bodies, const float deltaSecond,
+						 contact_t contacts[ MAX_MANIFOLD_CONTACTS ] );
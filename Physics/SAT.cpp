@@ -0,0 +1,738 @@
+//
+//  SAT.cpp
+//
+#include "PCH.h"
+#include "SAT.h"
+
+// an edge axis (or a face of B) only wins over a face of A when it separates clearly more,
+// otherwise the choice would flip between frames for resting shapes
+static const float AXIS_RELATIVE_TOLERANCE = 0.98f;
+static const float AXIS_ABSOLUTE_TOLERANCE = 0.001f;
+
+static const int MAX_CLIP_POINTS = 64;
+
+/*
+================================================================================================
+
+Clipping
+
+================================================================================================
+*/
+
+/*
+================================
+ClipPolygon
+
+Sutherland-Hodgman step, keeps the part of the polygon where planeNormal.Dot( p ) <= planeOffset.
+================================
+*/
+static int ClipPolygon(const Vec3* input, const int numInput, const Vec3& planeNormal, const float planeOffset, Vec3* output) {
+	int numOutput = 0;
+	for (int currentIndex = 0; currentIndex < numInput; ++currentIndex) {
+		const Vec3& current = input[currentIndex];
+		const Vec3& next = input[(currentIndex + 1) % numInput];
+		const float currentDistance = planeNormal.Dot(current) - planeOffset;
+		const float nextDistance = planeNormal.Dot(next) - planeOffset;
+
+		if (currentDistance <= 0.0f && numOutput < MAX_CLIP_POINTS)
+			output[numOutput++] = current;
+
+		// the edge crosses the plane
+		if ((currentDistance < 0.0f && nextDistance > 0.0f) || (currentDistance > 0.0f && nextDistance < 0.0f)) {
+			const float t = currentDistance / (currentDistance - nextDistance);
+			if (numOutput < MAX_CLIP_POINTS)
+				output[numOutput++] = current + (next - current) * t;
+		}
+	}
+	return numOutput;
+}
+
+/*
+================================
+ReduceContacts
+
+Keeps the deepest point, the point furthest from it,
+and the two points that span the largest triangles on either side of those two.
+================================
+*/
+static int ReduceContacts(const contact_t* candidates, const int numCandidates, const Vec3& normal, contact_t* contacts) {
+	if (numCandidates <= MAX_MANIFOLD_CONTACTS) {
+		for (int currentIndex = 0; currentIndex < numCandidates; ++currentIndex)
+			contacts[currentIndex] = candidates[currentIndex];
+		return numCandidates;
+	}
+
+	int first = 0;
+	for (int currentIndex = 1; currentIndex < numCandidates; ++currentIndex) {
+		if (candidates[currentIndex].separationDistance < candidates[first].separationDistance)
+			first = currentIndex;
+	}
+	const Vec3 pointFirst = candidates[first].ptOnA_WorldSpace;
+
+	int second = -1;
+	float maxDistance = -1.0f;
+	for (int currentIndex = 0; currentIndex < numCandidates; ++currentIndex) {
+		const float distance = (candidates[currentIndex].ptOnA_WorldSpace - pointFirst).GetLengthSqr();
+		if (currentIndex != first && distance > maxDistance) {
+			maxDistance = distance;
+			second = currentIndex;
+		}
+	}
+	const Vec3 edge = candidates[second].ptOnA_WorldSpace - pointFirst;
+
+	int third = -1;
+	int fourth = -1;
+	float maxArea = 0.0f;
+	float minArea = 0.0f;
+	for (int currentIndex = 0; currentIndex < numCandidates; ++currentIndex) {
+		const float area = edge.Cross(candidates[currentIndex].ptOnA_WorldSpace - pointFirst).Dot(normal);
+		if (area > maxArea) {
+			maxArea = area;
+			third = currentIndex;
+		}
+		if (area < minArea) {
+			minArea = area;
+			fourth = currentIndex;
+		}
+	}
+
+	int numContacts = 0;
+	contacts[numContacts++] = candidates[first];
+	contacts[numContacts++] = candidates[second];
+	if (-1 != third)
+		contacts[numContacts++] = candidates[third];
+	if (-1 != fourth)
+		contacts[numContacts++] = candidates[fourth];
+	return numContacts;
+}
+
+/*
+================================
+ClipIncidentFace
+
+Clips the incident face against the side planes of the reference face
+and turns every clipped point that penetrates the reference face into a contact.
+The reference normal points from the reference shape towards the incident shape.
+================================
+*/
+static int ClipIncidentFace(const Vec3* incidentPoints, const int numIncidentPoints, const Vec3* sideNormals, const float* sideOffsets, const int numSides,
+							const Vec3& referenceNormal, const float referenceOffset, const bool isReferenceA, const Vec3& normal, contact_t* contacts) {
+	Vec3 bufferA[MAX_CLIP_POINTS];
+	Vec3 bufferB[MAX_CLIP_POINTS];
+
+	int numPoints = std::min(numIncidentPoints, MAX_CLIP_POINTS);
+	for (int currentIndex = 0; currentIndex < numPoints; ++currentIndex)
+		bufferA[currentIndex] = incidentPoints[currentIndex];
+
+	Vec3* input = bufferA;
+	Vec3* output = bufferB;
+	for (int currentSide = 0; currentSide < numSides && numPoints > 0; ++currentSide) {
+		numPoints = ClipPolygon(input, numPoints, sideNormals[currentSide], sideOffsets[currentSide], output);
+		std::swap(input, output);
+	}
+
+	contact_t candidates[MAX_CLIP_POINTS];
+	int numCandidates = 0;
+	for (int currentIndex = 0; currentIndex < numPoints; ++currentIndex) {
+		const Vec3& point = input[currentIndex];
+		const float depth = referenceNormal.Dot(point) - referenceOffset;
+		// the manifold drops points that are not penetrating on the next step,
+		// adding them here would only throw their warm start away every frame
+		if (depth > 0.0f)
+			continue;
+
+		// project the incident point onto the reference face
+		const Vec3 pointOnReference = point - referenceNormal * depth;
+
+		contact_t& candidate = candidates[numCandidates++];
+		candidate.normal = normal;
+		candidate.separationDistance = depth;
+		candidate.timeOfImpact = 0.0f;
+		candidate.ptOnA_WorldSpace = isReferenceA ? pointOnReference : point;
+		candidate.ptOnB_WorldSpace = isReferenceA ? point : pointOnReference;
+	}
+
+	return ReduceContacts(candidates, numCandidates, normal, contacts);
+}
+
+/*
+================================
+GetEdgeContact
+
+The closest points of the two edge segments as a single contact.
+================================
+*/
+static int GetEdgeContact(const Vec3& startA, const Vec3& endA, const Vec3& startB, const Vec3& endB, const Vec3& normal, contact_t* contacts) {
+	const Vec3 directionA = endA - startA;
+	const Vec3 directionB = endB - startB;
+	const Vec3 r = startA - startB;
+	const float lengthSqrA = directionA.Dot(directionA);
+	const float lengthSqrB = directionB.Dot(directionB);
+	const float b = directionA.Dot(directionB);
+	const float c = directionA.Dot(r);
+	const float f = directionB.Dot(r);
+	const float denominator = lengthSqrA * lengthSqrB - b * b;
+
+	// parallel edges take any pair of closest points, starting from the start of A
+	float s = (denominator > 1e-6f * lengthSqrA * lengthSqrB) ? std::max(0.0f, std::min((b * f - c * lengthSqrB) / denominator, 1.0f)) : 0.0f;
+	float t = (lengthSqrB > 0.0f) ? (b * s + f) / lengthSqrB : 0.0f;
+	if (t < 0.0f || t > 1.0f) {
+		t = std::max(0.0f, std::min(t, 1.0f));
+		s = (lengthSqrA > 0.0f) ? std::max(0.0f, std::min((b * t - c) / lengthSqrA, 1.0f)) : 0.0f;
+	}
+
+	contact_t& contact = contacts[0];
+	contact.normal = normal;
+	contact.ptOnA_WorldSpace = startA + directionA * s;
+	contact.ptOnB_WorldSpace = startB + directionB * t;
+	contact.separationDistance = (contact.ptOnA_WorldSpace - contact.ptOnB_WorldSpace).Dot(normal);
+	contact.timeOfImpact = 0.0f;
+	return 1;
+}
+
+/*
+================================================================================================
+
+Box vs Box
+
+================================================================================================
+*/
+
+struct orientedBox_t {
+	Vec3 center;
+	Vec3 axes[3];
+	float halfExtents[3];
+};
+
+/*
+================================
+GetOrientedBox
+================================
+*/
+static orientedBox_t GetOrientedBox(const bodyTransform_t* body) {
+	const ShapeBox* box = (const ShapeBox*)body->shape;
+	const Bounds& bounds = box->m_bounds;
+
+	orientedBox_t result;
+	result.center = body->position + body->orientation.RotatePoint((bounds.mins + bounds.maxs) * 0.5f);
+	result.axes[0] = body->orientation.RotatePoint(Vec3(1, 0, 0));
+	result.axes[1] = body->orientation.RotatePoint(Vec3(0, 1, 0));
+	result.axes[2] = body->orientation.RotatePoint(Vec3(0, 0, 1));
+	for (int axis = 0; axis < 3; ++axis)
+		result.halfExtents[axis] = (bounds.maxs[axis] - bounds.mins[axis]) * 0.5f;
+	return result;
+}
+
+/*
+================================
+GetProjectedRadius
+================================
+*/
+static float GetProjectedRadius(const orientedBox_t& box, const Vec3& axis) {
+	return box.halfExtents[0] * fabsf(box.axes[0].Dot(axis))
+		+ box.halfExtents[1] * fabsf(box.axes[1].Dot(axis))
+		+ box.halfExtents[2] * fabsf(box.axes[2].Dot(axis));
+}
+
+/*
+================================
+ClipBoxFaces
+
+reference is the box that owns the face axis, and referenceNormal points towards the incident box.
+================================
+*/
+static int ClipBoxFaces(const orientedBox_t& reference, const int referenceAxis, const Vec3& referenceNormal, const orientedBox_t& incident,
+						const bool isReferenceA, const Vec3& normal, contact_t* contacts) {
+	const Vec3 referenceCenter = reference.center + referenceNormal * reference.halfExtents[referenceAxis];
+
+	// the four planes around the reference face
+	Vec3 sideNormals[4];
+	float sideOffsets[4];
+	int numSides = 0;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (axis == referenceAxis)
+			continue;
+		const float centerDistance = reference.axes[axis].Dot(reference.center);
+		sideNormals[numSides] = reference.axes[axis];
+		sideOffsets[numSides++] = centerDistance + reference.halfExtents[axis];
+		sideNormals[numSides] = reference.axes[axis] * -1.0f;
+		sideOffsets[numSides++] = -centerDistance + reference.halfExtents[axis];
+	}
+
+	// the incident face is the one most anti-parallel to the reference normal
+	int incidentAxis = 0;
+	float maxDot = -1.0f;
+	for (int axis = 0; axis < 3; ++axis) {
+		const float currentDot = fabsf(incident.axes[axis].Dot(referenceNormal));
+		if (currentDot > maxDot) {
+			maxDot = currentDot;
+			incidentAxis = axis;
+		}
+	}
+	const float sign = (incident.axes[incidentAxis].Dot(referenceNormal) > 0.0f) ? -1.0f : 1.0f;
+	const Vec3 incidentCenter = incident.center + incident.axes[incidentAxis] * (sign * incident.halfExtents[incidentAxis]);
+	const int axisU = (incidentAxis + 1) % 3;
+	const int axisV = (incidentAxis + 2) % 3;
+	const Vec3 u = incident.axes[axisU] * incident.halfExtents[axisU];
+	const Vec3 v = incident.axes[axisV] * incident.halfExtents[axisV];
+
+	const Vec3 incidentPoints[4] = {
+		incidentCenter + u + v,
+		incidentCenter - u + v,
+		incidentCenter - u - v,
+		incidentCenter + u - v
+	};
+
+	return ClipIncidentFace(incidentPoints, 4, sideNormals, sideOffsets, numSides,
+							referenceNormal, referenceNormal.Dot(referenceCenter), isReferenceA, normal, contacts);
+}
+
+/*
+================================
+GetBoxEdge
+
+The edge of the box along the given axis that is furthest in direction.
+================================
+*/
+static Vec3 GetBoxEdge(const orientedBox_t& box, const int edgeAxis, const Vec3& direction) {
+	Vec3 edgeCenter = box.center;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (axis == edgeAxis)
+			continue;
+		const float sign = (box.axes[axis].Dot(direction) > 0.0f) ? 1.0f : -1.0f;
+		edgeCenter += box.axes[axis] * (sign * box.halfExtents[axis]);
+	}
+	return edgeCenter;
+}
+
+/*
+================================
+FindContacts_BoxBox
+
+Tests the 3 face axes of each box and the 9 edge cross products.
+A face axis clips the incident face against the reference face for up to four contacts,
+an edge axis gives the single closest pair of points on the two edges.
+================================
+*/
+int FindContacts_BoxBox(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, contact_t* contacts) {
+	const orientedBox_t boxA = GetOrientedBox(bodyA);
+	const orientedBox_t boxB = GetOrientedBox(bodyB);
+	const Vec3 delta = boxA.center - boxB.center;
+
+	float separationA = -1e10f;
+	int faceA = -1;
+	for (int axis = 0; axis < 3; ++axis) {
+		const Vec3& currentAxis = boxA.axes[axis];
+		const float separation = fabsf(delta.Dot(currentAxis)) - (boxA.halfExtents[axis] + GetProjectedRadius(boxB, currentAxis));
+		if (separation > CONTACT_BIAS)
+			return 0;
+		if (separation > separationA) {
+			separationA = separation;
+			faceA = axis;
+		}
+	}
+
+	float separationB = -1e10f;
+	int faceB = -1;
+	for (int axis = 0; axis < 3; ++axis) {
+		const Vec3& currentAxis = boxB.axes[axis];
+		const float separation = fabsf(delta.Dot(currentAxis)) - (GetProjectedRadius(boxA, currentAxis) + boxB.halfExtents[axis]);
+		if (separation > CONTACT_BIAS)
+			return 0;
+		if (separation > separationB) {
+			separationB = separation;
+			faceB = axis;
+		}
+	}
+
+	float separationEdge = -1e10f;
+	int edgeA = -1;
+	int edgeB = -1;
+	Vec3 edgeAxis;
+	for (int axisA = 0; axisA < 3; ++axisA) {
+		for (int axisB = 0; axisB < 3; ++axisB) {
+			Vec3 currentAxis = boxA.axes[axisA].Cross(boxB.axes[axisB]);
+			const float length = currentAxis.GetMagnitude();
+			if (length < 1e-5f)
+				continue;	// parallel edges, the face axes already cover this direction
+			currentAxis /= length;
+
+			const float separation = fabsf(delta.Dot(currentAxis)) - (GetProjectedRadius(boxA, currentAxis) + GetProjectedRadius(boxB, currentAxis));
+			if (separation > CONTACT_BIAS)
+				return 0;
+			if (separation > separationEdge) {
+				separationEdge = separation;
+				edgeA = axisA;
+				edgeB = axisB;
+				edgeAxis = currentAxis;
+			}
+		}
+	}
+
+	// Edge contact
+	if (-1 != edgeA && separationEdge > AXIS_RELATIVE_TOLERANCE * std::max(separationA, separationB) + AXIS_ABSOLUTE_TOLERANCE) {
+		const Vec3 normal = (delta.Dot(edgeAxis) < 0.0f) ? edgeAxis * -1.0f : edgeAxis;
+
+		const Vec3 centerA = GetBoxEdge(boxA, edgeA, normal * -1.0f);
+		const Vec3 centerB = GetBoxEdge(boxB, edgeB, normal);
+		const Vec3 extentA = boxA.axes[edgeA] * boxA.halfExtents[edgeA];
+		const Vec3 extentB = boxB.axes[edgeB] * boxB.halfExtents[edgeB];
+		return GetEdgeContact(centerA - extentA, centerA + extentA, centerB - extentB, centerB + extentB, normal, contacts);
+	}
+
+	// Face contact
+	if (separationB > AXIS_RELATIVE_TOLERANCE * separationA + AXIS_ABSOLUTE_TOLERANCE) {
+		const Vec3 axis = boxB.axes[faceB];
+		const Vec3 normal = (delta.Dot(axis) < 0.0f) ? axis * -1.0f : axis;
+		return ClipBoxFaces(boxB, faceB, normal, boxA, false, normal, contacts);
+	}
+
+	const Vec3 axis = boxA.axes[faceA];
+	const Vec3 normal = (delta.Dot(axis) < 0.0f) ? axis * -1.0f : axis;
+	return ClipBoxFaces(boxA, faceA, normal * -1.0f, boxB, true, normal, contacts);
+}
+
+/*
+================================================================================================
+
+Convex vs Convex
+
+================================================================================================
+*/
+
+// edges closer to parallel than this leave the axis to the face queries
+static const float PARALLEL_EDGE_TOLERANCE = 0.005f;
+
+// maps the body space of one body into the body space of another, or into world space
+struct hullFrame_t {
+	Vec3 axes[3];
+	Vec3 origin;
+
+	Vec3 Rotate(const Vec3& direction) const { return axes[0] * direction.x + axes[1] * direction.y + axes[2] * direction.z; }
+	Vec3 Transform(const Vec3& point) const { return origin + Rotate(point); }
+};
+
+struct faceQuery_t {
+	float separation;
+	int face;
+};
+
+struct edgeQuery_t {
+	float separation;
+	int edgeA;
+	int edgeB;
+};
+
+/*
+================================
+GetWorldFrame
+================================
+*/
+static hullFrame_t GetWorldFrame(const bodyTransform_t* body) {
+	hullFrame_t frame;
+	frame.axes[0] = body->orientation.RotatePoint(Vec3(1, 0, 0));
+	frame.axes[1] = body->orientation.RotatePoint(Vec3(0, 1, 0));
+	frame.axes[2] = body->orientation.RotatePoint(Vec3(0, 0, 1));
+	frame.origin = body->position;
+	return frame;
+}
+
+/*
+================================
+GetRelativeFrame
+
+Takes points from the body space of from into the body space of to.
+================================
+*/
+static hullFrame_t GetRelativeFrame(const bodyTransform_t* from, const bodyTransform_t* to) {
+	const Quat toInverse = to->orientation.Inverse();
+	const hullFrame_t fromWorld = GetWorldFrame(from);
+
+	hullFrame_t frame;
+	for (int axis = 0; axis < 3; ++axis)
+		frame.axes[axis] = toInverse.RotatePoint(fromWorld.axes[axis]);
+	frame.origin = toInverse.RotatePoint(from->position - to->position);
+	return frame;
+}
+
+/*
+================================
+QueryFaceDirections
+
+The largest separation of hullB from the planes of the faces of hullA, measured in the body space of B.
+================================
+*/
+static faceQuery_t QueryFaceDirections(const ShapeConvex* hullA, const bodyTransform_t* bodyA, const ShapeConvex* hullB, const bodyTransform_t* bodyB) {
+	const hullFrame_t frame = GetRelativeFrame(bodyA, bodyB);
+
+	faceQuery_t query;
+	query.separation = -1e10f;
+	query.face = -1;
+	int supportVertex = -1;	// neighboring faces have close normals, each search starts where the last one ended
+	for (int faceIndex = 0; faceIndex < static_cast<int>(hullA->m_faces.size()); ++faceIndex) {
+		const hullFace_t& face = hullA->m_faces[faceIndex];
+		const Vec3 normal = frame.Rotate(face.normal);
+		const Vec3 pointOnPlane = frame.Transform(face.normal * face.distance);
+		supportVertex = hullB->GetSupportVertex(normal * -1.0f, supportVertex);
+		const Vec3& support = hullB->m_points[supportVertex];
+
+		const float separation = normal.Dot(support - pointOnPlane);
+		if (separation > query.separation) {
+			query.separation = separation;
+			query.face = faceIndex;
+			if (separation > CONTACT_BIAS)
+				break;
+		}
+	}
+	return query;
+}
+
+/*
+================================
+IsMinkowskiFace
+
+Two edges only build a face of the Minkowski difference when their arcs on the Gauss map cross.
+a and b are the normals of the faces around the edge of A, c and d the negated normals around the edge of B,
+bxa is the direction of the edge of A.
+================================
+*/
+static bool IsMinkowskiFace(const Vec3& a, const Vec3& b, const Vec3& bxa, const Vec3& c, const Vec3& d) {
+	// c and d lie on opposite sides of the arc ab, this alone rejects most pairs
+	const float cba = c.Dot(bxa);
+	const float dba = d.Dot(bxa);
+	if (cba * dba >= 0.0f)
+		return false;
+
+	// a and b lie on opposite sides of the arc cd, and both arcs are on the same hemisphere
+	const Vec3 dxc = d.Cross(c);
+	const float adc = a.Dot(dxc);
+	const float bdc = b.Dot(dxc);
+	return adc * bdc < 0.0f && cba * bdc > 0.0f;
+}
+
+/*
+================================
+QueryEdgeDirections
+
+Only the edge pairs that pass the Gauss map test are real candidates,
+which prunes almost all of the edgesA * edgesB cross products.
+Runs in the body space of B so that the inner loop reads the hull of B as it is.
+================================
+*/
+static edgeQuery_t QueryEdgeDirections(const ShapeConvex* hullA, const bodyTransform_t* bodyA, const ShapeConvex* hullB, const bodyTransform_t* bodyB) {
+	const hullFrame_t frame = GetRelativeFrame(bodyA, bodyB);
+	const Vec3 centerA = frame.Transform(hullA->GetCenterOfMass());
+	const int numEdgesB = static_cast<int>(hullB->m_edges.size());
+
+	// which side of the arc of the current edge of A every face normal of B is on.
+	// The scratch is kept per thread, this runs for every convex pair on the narrowphase workers
+	static thread_local std::vector< float > arcDistances;
+	static thread_local std::vector< int > candidates;
+	arcDistances.resize(hullB->m_faces.size());
+	candidates.resize(numEdgesB);
+
+	edgeQuery_t query;
+	query.separation = -1e10f;
+	query.edgeA = -1;
+	query.edgeB = -1;
+	for (int indexA = 0; indexA < static_cast<int>(hullA->m_edges.size()); ++indexA) {
+		const hullEdge_t& edgeA = hullA->m_edges[indexA];
+		const Vec3 pointA = frame.Transform(hullA->m_points[edgeA.a]);
+		const Vec3 directionA = frame.Rotate(hullA->m_points[edgeA.b] - hullA->m_points[edgeA.a]);
+		const Vec3 normalA1 = frame.Rotate(hullA->m_faces[edgeA.faceA].normal);
+		const Vec3 normalA2 = frame.Rotate(hullA->m_faces[edgeA.faceB].normal);
+		const Vec3 arcA = normalA2.Cross(normalA1);
+		for (int faceIndex = 0; faceIndex < static_cast<int>(hullB->m_faces.size()); ++faceIndex)
+			arcDistances[faceIndex] = hullB->m_faces[faceIndex].normal.Dot(arcA);
+
+		// The first half of IsMinkowskiFace, the faces of B have to be on both sides of the arc.
+		// Only a few edges pass, so collect them without a branch per edge instead of mispredicting half of them
+		int numCandidates = 0;
+		for (int indexB = 0; indexB < numEdgesB; ++indexB) {
+			const hullEdge_t& edgeB = hullB->m_edges[indexB];
+			candidates[numCandidates] = indexB;
+			numCandidates += (arcDistances[edgeB.faceA] * arcDistances[edgeB.faceB] < 0.0f) ? 1 : 0;
+		}
+
+		for (int candidateIndex = 0; candidateIndex < numCandidates; ++candidateIndex) {
+			const int indexB = candidates[candidateIndex];
+			const hullEdge_t& edgeB = hullB->m_edges[indexB];
+			const Vec3& normalB1 = hullB->m_faces[edgeB.faceA].normal;
+			const Vec3& normalB2 = hullB->m_faces[edgeB.faceB].normal;
+			if (!IsMinkowskiFace(normalA1, normalA2, arcA, normalB1 * -1.0f, normalB2 * -1.0f))
+				continue;
+
+			const Vec3& pointB = hullB->m_points[edgeB.a];
+			const Vec3 directionB = hullB->m_points[edgeB.b] - pointB;
+
+			Vec3 axis = directionA.Cross(directionB);
+			const float length = axis.GetMagnitude();
+			if (length < PARALLEL_EDGE_TOLERANCE * sqrtf(directionA.GetLengthSqr() * directionB.GetLengthSqr()))
+				continue;
+			axis /= length;
+
+			// point the axis away from A
+			if (axis.Dot(pointA - centerA) < 0.0f)
+				axis *= -1.0f;
+
+			const float separation = axis.Dot(pointB - pointA);
+			if (separation > query.separation) {
+				query.separation = separation;
+				query.edgeA = indexA;
+				query.edgeB = indexB;
+				if (separation > CONTACT_BIAS)
+					return query;
+			}
+		}
+	}
+	return query;
+}
+
+/*
+================================
+ClipHullFaces
+
+reference owns the face that won the face query and incident is the other hull.
+================================
+*/
+static int ClipHullFaces(const ShapeConvex* reference, const bodyTransform_t* referenceBody, const int referenceFace,
+						 const ShapeConvex* incident, const bodyTransform_t* incidentBody, const bool isReferenceA, contact_t* contacts) {
+	const hullFrame_t referenceFrame = GetWorldFrame(referenceBody);
+	const hullFrame_t incidentFrame = GetWorldFrame(incidentBody);
+
+	const hullFace_t& face = reference->m_faces[referenceFace];
+	const Vec3 referenceNormal = referenceFrame.Rotate(face.normal);
+	const float referenceOffset = referenceNormal.Dot(referenceFrame.Transform(face.normal * face.distance));
+
+	// one plane through every edge of the reference face, facing out of it
+	Vec3 sideNormals[MAX_CLIP_POINTS];
+	float sideOffsets[MAX_CLIP_POINTS];
+	const int numSides = std::min(face.numVertices, MAX_CLIP_POINTS);
+	for (int sideIndex = 0; sideIndex < numSides; ++sideIndex) {
+		const Vec3 start = referenceFrame.Transform(reference->m_points[reference->m_faceVertices[face.firstVertex + sideIndex]]);
+		const Vec3 end = referenceFrame.Transform(reference->m_points[reference->m_faceVertices[face.firstVertex + (sideIndex + 1) % face.numVertices]]);
+		sideNormals[sideIndex] = (end - start).Cross(referenceNormal);
+		sideNormals[sideIndex].Normalize();
+		sideOffsets[sideIndex] = sideNormals[sideIndex].Dot(start);
+	}
+
+	// the incident face is the one most anti-parallel to the reference normal
+	const Vec3 localNormal = incidentBody->orientation.Inverse().RotatePoint(referenceNormal);
+	int incidentFace = 0;
+	float minDot = 1e10f;
+	for (int faceIndex = 0; faceIndex < static_cast<int>(incident->m_faces.size()); ++faceIndex) {
+		const float currentDot = incident->m_faces[faceIndex].normal.Dot(localNormal);
+		if (currentDot < minDot) {
+			minDot = currentDot;
+			incidentFace = faceIndex;
+		}
+	}
+
+	const hullFace_t& clippedFace = incident->m_faces[incidentFace];
+	Vec3 incidentPoints[MAX_CLIP_POINTS];
+	const int numIncidentPoints = std::min(clippedFace.numVertices, MAX_CLIP_POINTS);
+	for (int vertexIndex = 0; vertexIndex < numIncidentPoints; ++vertexIndex)
+		incidentPoints[vertexIndex] = incidentFrame.Transform(incident->m_points[incident->m_faceVertices[clippedFace.firstVertex + vertexIndex]]);
+
+	const Vec3 normal = isReferenceA ? referenceNormal * -1.0f : referenceNormal;
+	return ClipIncidentFace(incidentPoints, numIncidentPoints, sideNormals, sideOffsets, numSides,
+							referenceNormal, referenceOffset, isReferenceA, normal, contacts);
+}
+
+/*
+================================
+FindContacts_ConvexFaces
+
+The face of each hull that faces the other one along the normal (from B towards A) is looked up directly.
+The better aligned one is the reference face and the other hull's face is clipped against it.
+Returns 0 when neither face lines up with the normal, that contact is on an edge or a corner.
+================================
+*/
+int FindContacts_ConvexFaces(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, const Vec3& normal, contact_t* contacts) {
+	// about 8 degrees, the core normal of a resting pair tilts a little from the face it rests on
+	const float FACE_ALIGNMENT_COSINE = 0.99f;
+
+	const ShapeConvex* hullA = (const ShapeConvex*)bodyA->shape;
+	const ShapeConvex* hullB = (const ShapeConvex*)bodyB->shape;
+	const Vec3 directionA = bodyA->orientation.Inverse().RotatePoint(normal * -1.0f);
+	const Vec3 directionB = bodyB->orientation.Inverse().RotatePoint(normal);
+
+	int faceA = 0;
+	float alignmentA = -1.0f;
+	for (int faceIndex = 0; faceIndex < static_cast<int>(hullA->m_faces.size()); ++faceIndex) {
+		const float alignment = hullA->m_faces[faceIndex].normal.Dot(directionA);
+		if (alignment > alignmentA) {
+			alignmentA = alignment;
+			faceA = faceIndex;
+		}
+	}
+
+	int faceB = 0;
+	float alignmentB = -1.0f;
+	for (int faceIndex = 0; faceIndex < static_cast<int>(hullB->m_faces.size()); ++faceIndex) {
+		const float alignment = hullB->m_faces[faceIndex].normal.Dot(directionB);
+		if (alignment > alignmentB) {
+			alignmentB = alignment;
+			faceB = faceIndex;
+		}
+	}
+
+	if (std::max(alignmentA, alignmentB) < FACE_ALIGNMENT_COSINE)
+		return 0;
+
+	// B only wins when clearly better aligned, as in the full test, so a resting pair keeps its reference face
+	if (alignmentB > alignmentA + AXIS_ABSOLUTE_TOLERANCE)
+		return ClipHullFaces(hullB, bodyB, faceB, hullA, bodyA, false, contacts);
+	return ClipHullFaces(hullA, bodyA, faceA, hullB, bodyB, true, contacts);
+}
+
+/*
+================================
+FindContacts_ConvexConvex
+
+Tests the merged faces of both hulls and the edge pairs that survive the Gauss map test.
+A face axis clips the incident face against the reference face for up to four contacts,
+an edge axis gives the single closest pair of points on the two edges.
+================================
+*/
+int FindContacts_ConvexConvex(const bodyTransform_t* bodyA, const bodyTransform_t* bodyB, contact_t* contacts) {
+	const ShapeConvex* hullA = (const ShapeConvex*)bodyA->shape;
+	const ShapeConvex* hullB = (const ShapeConvex*)bodyB->shape;
+
+	const faceQuery_t faceQueryA = QueryFaceDirections(hullA, bodyA, hullB, bodyB);
+	if (faceQueryA.separation > CONTACT_BIAS)
+		return 0;
+
+	const faceQuery_t faceQueryB = QueryFaceDirections(hullB, bodyB, hullA, bodyA);
+	if (faceQueryB.separation > CONTACT_BIAS)
+		return 0;
+
+	const edgeQuery_t edgeQuery = QueryEdgeDirections(hullA, bodyA, hullB, bodyB);
+	if (edgeQuery.separation > CONTACT_BIAS)
+		return 0;
+
+	// Edge contact
+	const float faceSeparation = std::max(faceQueryA.separation, faceQueryB.separation);
+	if (-1 != edgeQuery.edgeA && edgeQuery.separation > AXIS_RELATIVE_TOLERANCE * faceSeparation + AXIS_ABSOLUTE_TOLERANCE) {
+		const hullFrame_t frameA = GetWorldFrame(bodyA);
+		const hullFrame_t frameB = GetWorldFrame(bodyB);
+		const hullEdge_t& edgeA = hullA->m_edges[edgeQuery.edgeA];
+		const hullEdge_t& edgeB = hullB->m_edges[edgeQuery.edgeB];
+		const Vec3 startA = frameA.Transform(hullA->m_points[edgeA.a]);
+		const Vec3 endA = frameA.Transform(hullA->m_points[edgeA.b]);
+		const Vec3 startB = frameB.Transform(hullB->m_points[edgeB.a]);
+		const Vec3 endB = frameB.Transform(hullB->m_points[edgeB.b]);
+
+		// the query axis pointed away from A, the contact normal points towards it
+		Vec3 normal = (endA - startA).Cross(endB - startB);
+		normal.Normalize();
+		if (normal.Dot(startA - frameA.Transform(hullA->GetCenterOfMass())) > 0.0f)
+			normal *= -1.0f;
+		return GetEdgeContact(startA, endA, startB, endB, normal, contacts);
+	}
+
+	// Face contact
+	if (faceQueryB.separation > AXIS_RELATIVE_TOLERANCE * faceQueryA.separation + AXIS_ABSOLUTE_TOLERANCE)
+		return ClipHullFaces(hullB, bodyB, faceQueryB.face, hullA, bodyA, false, contacts);
+	return ClipHullFaces(hullA, bodyA, faceQueryA.face, hullB, bodyB, true, contacts);
+}
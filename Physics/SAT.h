@@ -0,0 +1,15 @@
+//
+//	SAT.h
+//
+#pragma once
+#include "Contact.h"
+
+// Separating axis tests that build a whole contact manifold in one step.
+// They return the number of contacts written (0 when the shapes are apart) and fill the
+// world space points, the normal (from B towards A) and the separation of every contact.
+int FindContacts_BoxBox( const bodyTransform_t * bodyA, const bodyTransform_t * bodyB, contact_t * contacts );
+int FindContacts_ConvexConvex( const bodyTransform_t * bodyA, const bodyTransform_t * bodyB, contact_t * contacts );
+
+// The face manifold of two hulls for a contact normal that is already known (from B towards A),
+// 0 when the contact is not between two faces
+int FindContacts_ConvexFaces( const bodyTransform_t * bodyA, const bodyTransform_t * bodyB, const Vec3 & normal, contact_t * contacts );
@@ -3,6 +3,11 @@
 //
 #pragma once
 
+// how far the polytopes shrink for their core, see Shape::GetMargin,
+// and how far the rounded edges and corners of the core with the margin may cut into the shape
+static const float POLYTOPE_MARGIN = 0.02f;
+static const float POLYTOPE_MAX_ROUNDING = 0.01f;
+
 /*
 ====================================================
 Shape
@@ -13,6 +18,20 @@ public:
 	virtual void Build(const Vec3* initialPoints, const int numberOfPoints) {};
 	virtual Vec3 GetSupportPoint(const Vec3& dir, const Vec3& pos, const Quat& orient, const float bias) const = 0;
 
+	// GetSupportPoint for repeated queries, shapes made of points start searching at supportVertex
+	// and leave the one they found there (-1 for none), the others ignore it
+	virtual Vec3 GetSupportPointFrom(const Vec3& dir, const Vec3& pos, const Quat& orient, const float bias, int& supportVertex) const {
+		return GetSupportPoint(dir, pos, orient, bias);
+	}
+
+	// Polytopes can also be queried as their core, the shape shrunk by its margin.
+	// The core with the margin around it is the shape again, only rounded off at the edges and corners.
+	// Shapes without a margin are their own core
+	virtual float GetMargin() const { return 0.0f; }
+	virtual Vec3 GetCoreSupportPointFrom(const Vec3& dir, const Vec3& pos, const Quat& orient, int& supportVertex) const {
+		return GetSupportPointFrom(dir, pos, orient, 0.0f, supportVertex);
+	}
+
 	virtual Mat3 GetInertiaTensor() const = 0;
 
 	virtual Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const = 0;
@@ -20,6 +39,16 @@ public:
 
 	virtual Vec3 GetCenterOfMass() const { return m_centerOfMass; }
 
+	// radius of a sphere around the center of mass that holds the whole shape,
+	// the farthest corner of the bounds unless the shape knows better
+	virtual float GetBoundingRadius() const {
+		const Bounds bounds = GetBounds();
+		Vec3 farthestCorner;
+		for (int axis = 0; axis < 3; ++axis)
+			farthestCorner[axis] = std::max(fabsf(bounds.mins[axis] - m_centerOfMass[axis]), fabsf(bounds.maxs[axis] - m_centerOfMass[axis]));
+		return farthestCorner.GetMagnitude();
+	}
+
 	enum shapeType_t {
 		SHAPE_SPHERE,
 		SHAPE_BOX,
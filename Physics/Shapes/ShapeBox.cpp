@@ -33,19 +33,33 @@ void ShapeBox::Build(const Vec3* pts, const int num) {
 	m_points.push_back(Vec3(m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.mins.z));
 
 	m_centerOfMass = (m_bounds.maxs + m_bounds.mins) * 0.5f;
+
+	// Keep the core at least a fifth of the box wide on every axis,
+	// and the corners, which the rounding cuts into by ( sqrt( 3 ) - 1 ) * margin, close enough to the box
+	const Vec3 widths = m_bounds.maxs - m_bounds.mins;
+	m_margin = std::min(POLYTOPE_MARGIN, std::min(widths.x, std::min(widths.y, widths.z)) * 0.4f);
+	m_margin = std::min(m_margin, POLYTOPE_MAX_ROUNDING / (sqrtf(3.0f) - 1.0f));
+
+	m_corePoints.clear();
+	for (const Vec3& point : m_points) {
+		Vec3 corePoint = point;
+		for (int axis = 0; axis < 3; ++axis)
+			corePoint[axis] += (corePoint[axis] < m_centerOfMass[axis]) ? m_margin : -m_margin;
+		m_corePoints.push_back(corePoint);
+	}
 }
 
 /*
 ====================================================
-ShapeBox::GetSupportPoint
+FindSupportPoint
 ====================================================
 */
-Vec3 ShapeBox::GetSupportPoint( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
+static Vec3 FindSupportPoint(const std::vector< Vec3 >& points, const Vec3& dir, const Vec3& pos, const Quat& orient) {
 	// Find the point in furthest in direction
-	Vec3 currentSupportPoint = orient.RotatePoint(m_points[0]) + pos;
+	Vec3 currentSupportPoint = orient.RotatePoint(points[0]) + pos;
 	float currentMaximumDistance = dir.Dot(currentSupportPoint);
-	for (int currentIndex = 1; currentIndex < m_points.size(); ++currentIndex) {
-		const Vec3 currentPoint = orient.RotatePoint(m_points[currentIndex]) + pos;
+	for (int currentIndex = 1; currentIndex < points.size(); ++currentIndex) {
+		const Vec3 currentPoint = orient.RotatePoint(points[currentIndex]) + pos;
 		const float currentDistance = dir.Dot(currentPoint);
 
 		if (currentDistance > currentMaximumDistance) {
@@ -53,6 +67,16 @@ Vec3 ShapeBox::GetSupportPoint( const Vec3 & dir, const Vec3 & pos, const Quat &
 			currentSupportPoint = currentPoint;
 		}
 	}
+	return currentSupportPoint;
+}
+
+/*
+====================================================
+ShapeBox::GetSupportPoint
+====================================================
+*/
+Vec3 ShapeBox::GetSupportPoint( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
+	const Vec3 currentSupportPoint = FindSupportPoint(m_points, dir, pos, orient);
 
 	Vec3 normal = dir;
 	normal.Normalize();
@@ -61,6 +85,15 @@ Vec3 ShapeBox::GetSupportPoint( const Vec3 & dir, const Vec3 & pos, const Quat &
 	return currentSupportPoint + normal;
 }
 
+/*
+====================================================
+ShapeBox::GetCoreSupportPointFrom
+====================================================
+*/
+Vec3 ShapeBox::GetCoreSupportPointFrom( const Vec3 & dir, const Vec3 & pos, const Quat & orient, int & supportVertex ) const {
+	return FindSupportPoint(m_corePoints, dir, pos, orient);
+}
+
 /*
 ====================================================
 ShapeBox::GetInertiaTensor
@@ -18,6 +18,9 @@ public:
 
 	Vec3 GetSupportPoint( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
 
+	float GetMargin() const override { return m_margin; }
+	Vec3 GetCoreSupportPointFrom( const Vec3 & dir, const Vec3 & pos, const Quat & orient, int & supportVertex ) const override;
+
 	Mat3 GetInertiaTensor() const override;
 
 	Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const override;
@@ -30,4 +33,7 @@ public:
 public:
 	std::vector< Vec3 > m_points;
 	Bounds m_bounds;
+
+	std::vector< Vec3 > m_corePoints;	// the corners moved in by m_margin along every axis
+	float m_margin;
 };
@@ -594,6 +594,320 @@ void BuildConvexHull(const std::vector< Vec3 >& vertices, std::vector< Vec3 >& h
 	ExpandConvexHull(hullPoints, hullTris, vertices);
 }
 
+/*
+====================================================
+BuildHullFaces
+
+Merges the coplanar triangles of the hull into polygons and collects the edges between them.
+A face of a convex hull is a single connected patch, so every triangle in the same plane belongs to it.
+====================================================
+*/
+void BuildHullFaces(const std::vector< Vec3 >& hullPoints, const std::vector< tri_t >& hullTris,
+					std::vector< hullFace_t >& faces, std::vector< int >& faceVertices, std::vector< hullEdge_t >& edges) {
+	const float COPLANAR_COSINE = 0.9999f;
+	const float COPLANAR_DISTANCE = 0.001f;
+
+	faces.clear();
+	faceVertices.clear();
+	edges.clear();
+
+	const int numTris = static_cast<int>(hullTris.size());
+	std::vector< Vec3 > triNormals(numTris);
+	for (int triIndex = 0; triIndex < numTris; ++triIndex) {
+		const tri_t& tri = hullTris[triIndex];
+		const Vec3& a = hullPoints[tri.a];
+		triNormals[triIndex] = (hullPoints[tri.b] - a).Cross(hullPoints[tri.c] - a);
+		triNormals[triIndex].Normalize();
+	}
+
+	std::vector< int > triFaces(numTris, -1);
+	std::set< std::pair< int, int > > boundary;
+	std::map< int, int > nextVertices;	// start vertex -> end vertex of the edges on the border of the face
+	for (int triIndex = 0; triIndex < numTris; ++triIndex) {
+		if (-1 != triFaces[triIndex])
+			continue;
+
+		const Vec3& normal = triNormals[triIndex];
+		const float distance = normal.Dot(hullPoints[hullTris[triIndex].a]);
+		const int faceIndex = static_cast<int>(faces.size());
+
+		// Directed edges that only show up once are on the border, the inner ones cancel with their twin
+		boundary.clear();
+		for (int otherIndex = triIndex; otherIndex < numTris; ++otherIndex) {
+			if (-1 != triFaces[otherIndex] || triNormals[otherIndex].Dot(normal) < COPLANAR_COSINE)
+				continue;
+			const tri_t& tri = hullTris[otherIndex];
+			if (fabsf(normal.Dot(hullPoints[tri.a]) - distance) > COPLANAR_DISTANCE)
+				continue;
+
+			triFaces[otherIndex] = faceIndex;
+			const int triVertices[3] = { tri.a, tri.b, tri.c };
+			for (int edgeIndex = 0; edgeIndex < 3; ++edgeIndex) {
+				const int start = triVertices[edgeIndex];
+				const int end = triVertices[(edgeIndex + 1) % 3];
+				if (0 == boundary.erase(std::make_pair(end, start)))
+					boundary.insert(std::make_pair(start, end));
+			}
+		}
+
+		nextVertices.clear();
+		for (const std::pair< int, int >& edge : boundary)
+			nextVertices[edge.first] = edge.second;
+
+		hullFace_t face;
+		face.normal = normal;
+		face.distance = distance;
+		face.firstVertex = static_cast<int>(faceVertices.size());
+		face.numVertices = 0;
+
+		// Walk the border, the triangles are counter clockwise so the polygon is too
+		const int firstVertex = nextVertices.begin()->first;
+		int currentVertex = firstVertex;
+		do {
+			faceVertices.push_back(currentVertex);
+			++face.numVertices;
+			currentVertex = nextVertices[currentVertex];
+		} while (currentVertex != firstVertex && face.numVertices < static_cast<int>(nextVertices.size()));
+
+		faces.push_back(face);
+	}
+
+	// Every border edge is shared by two faces, running in opposite directions
+	std::map< std::pair< int, int >, int > edgeIndices;
+	for (int faceIndex = 0; faceIndex < static_cast<int>(faces.size()); ++faceIndex) {
+		const hullFace_t& face = faces[faceIndex];
+		for (int vertexIndex = 0; vertexIndex < face.numVertices; ++vertexIndex) {
+			const int start = faceVertices[face.firstVertex + vertexIndex];
+			const int end = faceVertices[face.firstVertex + (vertexIndex + 1) % face.numVertices];
+			const std::pair< int, int > key(std::min(start, end), std::max(start, end));
+
+			std::map< std::pair< int, int >, int >::iterator existing = edgeIndices.find(key);
+			if (existing != edgeIndices.end()) {
+				edges[existing->second].faceB = faceIndex;
+				continue;
+			}
+
+			hullEdge_t edge;
+			edge.a = start;
+			edge.b = end;
+			edge.faceA = faceIndex;
+			edge.faceB = -1;
+			edgeIndices[key] = static_cast<int>(edges.size());
+			edges.push_back(edge);
+		}
+	}
+
+	// A hull that did not close up leaves edges with one face, they have no arc on the Gauss map
+	edges.erase(std::remove_if(edges.begin(), edges.end(), [](const hullEdge_t& edge) { return -1 == edge.faceB; }), edges.end());
+}
+
+/*
+====================================================
+BuildHullAdjacency
+====================================================
+*/
+void BuildHullAdjacency(const int numPoints, const std::vector< tri_t >& hullTris, hullAdjacency_t& adjacency) {
+	std::vector< std::vector< int > > pointNeighbors(numPoints);
+	for (const tri_t& tri : hullTris) {
+		const int triVertices[3] = { tri.a, tri.b, tri.c };
+		for (int edgeIndex = 0; edgeIndex < 3; ++edgeIndex)
+			pointNeighbors[triVertices[edgeIndex]].push_back(triVertices[(edgeIndex + 1) % 3]);
+	}
+
+	adjacency.offsets.resize(numPoints + 1);
+	adjacency.neighbors.clear();
+	for (int pointIndex = 0; pointIndex < numPoints; ++pointIndex) {
+		// A closed hull already lists every neighbor once, an open one may not
+		std::vector< int >& neighbors = pointNeighbors[pointIndex];
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+		adjacency.offsets[pointIndex] = static_cast<int>(adjacency.neighbors.size());
+		adjacency.neighbors.insert(adjacency.neighbors.end(), neighbors.begin(), neighbors.end());
+	}
+	adjacency.offsets[numPoints] = static_cast<int>(adjacency.neighbors.size());
+}
+
+/*
+====================================================
+BuildSupportHierarchy
+
+Every level drops a set of points of low degree that are not neighbors of each other and takes the hull of the rest.
+The best point of a level is then either the best point of the level above or one of its dropped neighbors,
+so climbing down the levels takes a couple of steps on each and the levels shrink geometrically.
+====================================================
+*/
+void BuildSupportHierarchy(const std::vector< Vec3 >& hullPoints, const std::vector< tri_t >& hullTris,
+						   std::vector< hullAdjacency_t >& levels, std::vector< int >& topVertices) {
+	const int MAX_TOP_VERTICES = 8;
+	const int MAX_DROPPED_DEGREE = 8;
+	const int numPoints = static_cast<int>(hullPoints.size());
+
+	levels.clear();
+	levels.resize(1);
+	BuildHullAdjacency(numPoints, hullTris, levels[0]);
+
+	topVertices.resize(numPoints);
+	for (int pointIndex = 0; pointIndex < numPoints; ++pointIndex)
+		topVertices[pointIndex] = pointIndex;
+
+	std::vector< bool > isNeighborDropped(numPoints);
+	std::vector< int > keptVertices;
+	std::vector< Vec3 > keptPoints;
+	std::vector< Vec3 > levelPoints;
+	std::vector< tri_t > levelTris;
+	while (static_cast<int>(topVertices.size()) > MAX_TOP_VERTICES) {
+		const hullAdjacency_t& level = levels.back();
+
+		std::fill(isNeighborDropped.begin(), isNeighborDropped.end(), false);
+		keptVertices.clear();
+		keptPoints.clear();
+		for (const int vertex : topVertices) {
+			const int firstNeighbor = level.offsets[vertex];
+			const int lastNeighbor = level.offsets[vertex + 1];
+			if (!isNeighborDropped[vertex] && lastNeighbor - firstNeighbor <= MAX_DROPPED_DEGREE) {
+				for (int neighborIndex = firstNeighbor; neighborIndex < lastNeighbor; ++neighborIndex)
+					isNeighborDropped[level.neighbors[neighborIndex]] = true;
+				continue;
+			}
+			keptVertices.push_back(vertex);
+			keptPoints.push_back(hullPoints[vertex]);
+		}
+		if (keptVertices.size() < 4 || keptVertices.size() == topVertices.size())
+			break;
+
+		levelPoints.clear();
+		levelTris.clear();
+		BuildConvexHull(keptPoints, levelPoints, levelTris);
+		if (levelTris.empty())
+			break;
+
+		// The hull copies the points it keeps, find them again to get back to indices into the full hull
+		std::vector< int > levelVertices(levelPoints.size());
+		for (int pointIndex = 0; pointIndex < static_cast<int>(levelPoints.size()); ++pointIndex) {
+			const int keptIndex = static_cast<int>(std::find(keptPoints.begin(), keptPoints.end(), levelPoints[pointIndex]) - keptPoints.begin());
+			levelVertices[pointIndex] = keptVertices[keptIndex];
+		}
+		for (tri_t& tri : levelTris) {
+			tri.a = levelVertices[tri.a];
+			tri.b = levelVertices[tri.b];
+			tri.c = levelVertices[tri.c];
+		}
+
+		levels.emplace_back();
+		BuildHullAdjacency(numPoints, levelTris, levels.back());
+		topVertices = levelVertices;
+	}
+}
+
+/*
+====================================================
+BuildHullCore
+
+Moves every point in so that the planes of the faces around it move in by the margin,
+a point on more than three planes takes the least squares fit of them.
+Hulls too thin for the margin, or with corners so sharp the rounding would cut off too much of them,
+try again with half of it. The margin that worked is returned (zero with the points left as they are).
+====================================================
+*/
+float BuildHullCore(const std::vector< Vec3 >& hullPoints, const std::vector< tri_t >& hullTris, const std::vector< hullFace_t >& faces,
+					const float margin, std::vector< Vec3 >& corePoints) {
+	const float COPLANAR_COSINE = 0.9999f;
+	const float MIN_MARGIN_FRACTION = 0.1f;
+	const int numPoints = static_cast<int>(hullPoints.size());
+
+	// The different planes around every point
+	std::vector< std::vector< Vec3 > > pointNormals(numPoints);
+	for (const tri_t& tri : hullTris) {
+		const Vec3& a = hullPoints[tri.a];
+		Vec3 normal = (hullPoints[tri.b] - a).Cross(hullPoints[tri.c] - a);
+		normal.Normalize();
+
+		const int triVertices[3] = { tri.a, tri.b, tri.c };
+		for (const int vertex : triVertices) {
+			std::vector< Vec3 >& normals = pointNormals[vertex];
+			bool isNew = true;
+			for (const Vec3& existingNormal : normals)
+				isNew = isNew && existingNormal.Dot(normal) < COPLANAR_COSINE;
+			if (isNew)
+				normals.push_back(normal);
+		}
+	}
+
+	// Solve ( sum n n^T ) offset = -sum n, the offset for a margin of one.
+	// The small diagonal keeps points on one or two planes solvable, they just move straight in from those.
+	std::vector< Vec3 > unitOffsets(numPoints);
+	for (int pointIndex = 0; pointIndex < numPoints; ++pointIndex) {
+		Mat3 normalMatrix;
+		normalMatrix.Identity();
+		normalMatrix *= 1e-3f;
+		Vec3 normalSum(0.0f);
+		for (const Vec3& normal : pointNormals[pointIndex]) {
+			for (int row = 0; row < 3; ++row)
+				normalMatrix.rows[row] += normal * normal[row];
+			normalSum += normal;
+		}
+		unitOffsets[pointIndex] = normalMatrix.Inverse() * (normalSum * -1.0f);
+	}
+
+	corePoints.resize(numPoints);
+	for (float currentMargin = margin; currentMargin >= margin * MIN_MARGIN_FRACTION; currentMargin *= 0.5f) {
+		const float tolerance = currentMargin * 0.1f;
+		bool isValid = true;
+		for (int pointIndex = 0; pointIndex < numPoints && isValid; ++pointIndex) {
+			const Vec3 offset = unitOffsets[pointIndex] * currentMargin;
+			corePoints[pointIndex] = hullPoints[pointIndex] + offset;
+
+			// A sharp corner moves in further than the margin, and the margin only rounds it off from there
+			const float roundingError = offset.GetMagnitude() - currentMargin;
+			isValid = offset.IsValid() && roundingError <= POLYTOPE_MAX_ROUNDING;
+			for (const Vec3& normal : pointNormals[pointIndex])
+				isValid = isValid && fabsf(normal.Dot(offset) + currentMargin) <= tolerance;
+		}
+
+		// The core has to stay inside every face moved in by the margin
+		for (int faceIndex = 0; faceIndex < static_cast<int>(faces.size()) && isValid; ++faceIndex) {
+			const hullFace_t& face = faces[faceIndex];
+			for (const Vec3& corePoint : corePoints)
+				isValid = isValid && face.normal.Dot(corePoint) <= face.distance - currentMargin + tolerance;
+		}
+
+		if (isValid)
+			return currentMargin;
+	}
+
+	corePoints = hullPoints;
+	return 0.0f;
+}
+
+
+/*
+====================================================
+BuildCoreSupportHierarchy
+
+The core is a least squares shrink of the hull, not a scaled copy, so its points can lose
+the convex position the hull had and the hull's neighbors are no longer a safe graph to climb.
+The core gets the hull of its own points and a hierarchy built on that, indexed like corePoints.
+Points that end up inside the core hull have no neighbors, they are never the best point.
+====================================================
+*/
+void BuildCoreSupportHierarchy(const std::vector< Vec3 >& corePoints, std::vector< hullAdjacency_t >& levels, std::vector< int >& topVertices) {
+	std::vector< Vec3 > coreHullPoints;
+	std::vector< tri_t > coreHullTris;
+	BuildConvexHull(corePoints, coreHullPoints, coreHullTris);
+
+	// The hull copies the points it keeps, find them again to get back to indices into corePoints
+	std::vector< int > coreVertices(coreHullPoints.size());
+	for (int pointIndex = 0; pointIndex < static_cast<int>(coreHullPoints.size()); ++pointIndex)
+		coreVertices[pointIndex] = static_cast<int>(std::find(corePoints.begin(), corePoints.end(), coreHullPoints[pointIndex]) - corePoints.begin());
+	for (tri_t& tri : coreHullTris) {
+		tri.a = coreVertices[tri.a];
+		tri.b = coreVertices[tri.b];
+		tri.c = coreVertices[tri.c];
+	}
+
+	BuildSupportHierarchy(corePoints, coreHullTris, levels, topVertices);
+}
 
 /*
 ========================================================================================================
@@ -619,8 +933,22 @@ void ShapeConvex::Build(const Vec3* points, const int totalNumberOfPoints) {
 	std::vector< tri_t > hullTriangles;
 	BuildConvexHull(m_points, hullPoints, hullTriangles);
 	m_points = hullPoints;
-	// todo
 	m_triangles = hullTriangles;
+	// padded to whole SIMD registers with copies of the last point, which never win a support search over it
+	for (int axis = 0; axis < 3; ++axis) {
+		m_pointCoordinates[axis].resize((m_points.size() + 3) & ~3, m_points.back()[axis]);
+		for (int currentPointIndex = 0; currentPointIndex < m_points.size(); ++currentPointIndex)
+			m_pointCoordinates[axis][currentPointIndex] = m_points[currentPointIndex][axis];
+	}
+	BuildHullFaces(m_points, m_triangles, m_faces, m_faceVertices, m_edges);
+	BuildSupportHierarchy(m_points, m_triangles, m_supportLevels, m_topVertices);
+	m_margin = BuildHullCore(m_points, m_triangles, m_faces, POLYTOPE_MARGIN, m_corePoints);
+	if (m_margin > 0.0f)
+		BuildCoreSupportHierarchy(m_corePoints, m_coreSupportLevels, m_coreTopVertices);
+	else {
+		m_coreSupportLevels = m_supportLevels;
+		m_coreTopVertices = m_topVertices;
+	}
 
 	// Expand the bounds
 	m_bounds.Clear();
@@ -628,6 +956,10 @@ void ShapeConvex::Build(const Vec3* points, const int totalNumberOfPoints) {
 
 	m_centerOfMass = CalculateCenterOfMassUsingTetrahedrons(hullPoints, hullTriangles);
 
+	m_boundingRadius = 0.0f;
+	for (const Vec3& point : m_points)
+		m_boundingRadius = std::max(m_boundingRadius, (point - m_centerOfMass).GetMagnitude());
+
 	m_inertiaTensor = CalculateInertiaTensorUsingTetrahedrons(hullPoints, hullTriangles, m_centerOfMass);
 }
 
@@ -637,18 +969,20 @@ ShapeConvex::GetSupportPoint
 ====================================================
 */
 Vec3 ShapeConvex::GetSupportPoint(const Vec3& dir, const Vec3& pos, const Quat& orient, const float bias) const {
-	// Find the point in furthest in direction
-	Vec3 supportPoint = orient.RotatePoint(m_points[0]) + pos;
-	float currentMaxDistance = dir.Dot(supportPoint);
-	for (int i = 1; i < m_points.size(); i++) {
-		const Vec3 currentPoint = orient.RotatePoint(m_points[i]) + pos;
-		const float currentDistance = dir.Dot(currentPoint);
+	int supportVertex = -1;
+	return GetSupportPointFrom(dir, pos, orient, bias, supportVertex);
+}
 
-		if (currentDistance > currentMaxDistance) {
-			currentMaxDistance = currentDistance;
-			supportPoint = currentPoint;
-		}
-	}
+/*
+====================================================
+ShapeConvex::GetSupportPointFrom
+====================================================
+*/
+Vec3 ShapeConvex::GetSupportPointFrom(const Vec3& dir, const Vec3& pos, const Quat& orient, const float bias, int& supportVertex) const {
+	// Search in body space, only the direction and the winning point get rotated
+	const Vec3 localDir = orient.Inverse().RotatePoint(dir);
+	supportVertex = GetSupportVertex(localDir, supportVertex);
+	const Vec3 supportPoint = orient.RotatePoint(m_points[supportVertex]) + pos;
 
 	Vec3 norm = dir;
 	norm.Normalize();
@@ -657,6 +991,91 @@ Vec3 ShapeConvex::GetSupportPoint(const Vec3& dir, const Vec3& pos, const Quat&
 	return supportPoint + norm;
 }
 
+/*
+====================================================
+ClimbHull
+
+Moves to the best neighbor for as long as there is a better one.
+On a convex hull a point without a better neighbor is the best point of the whole hull.
+====================================================
+*/
+static int ClimbHull(const hullAdjacency_t& adjacency, const std::vector< Vec3 >& points, const Vec3& dir, int vertex) {
+	float maxDistance = dir.Dot(points[vertex]);
+	bool hasMoved = true;
+	while (hasMoved) {
+		hasMoved = false;
+		const int lastNeighbor = adjacency.offsets[vertex + 1];
+		for (int neighborIndex = adjacency.offsets[vertex]; neighborIndex < lastNeighbor; ++neighborIndex) {
+			const int neighbor = adjacency.neighbors[neighborIndex];
+			const float distance = dir.Dot(points[neighbor]);
+			if (distance > maxDistance) {
+				maxDistance = distance;
+				vertex = neighbor;
+				hasMoved = true;
+			}
+		}
+	}
+	return vertex;
+}
+
+/*
+====================================================
+FindSupportVertex
+
+Shared by the hull and its core, each with its own hierarchy.
+A start vertex without neighbors (a core point inside the core hull) can not be climbed from.
+====================================================
+*/
+static int FindSupportVertex(const std::vector< hullAdjacency_t >& levels, const std::vector< int >& topVertices, const std::vector< Vec3 >& points,
+							 const Vec3& localDir, const int startVertex) {
+	const hullAdjacency_t& hull = levels[0];
+	if (startVertex >= 0 && startVertex < static_cast<int>(points.size()) && hull.offsets[startVertex] != hull.offsets[startVertex + 1])
+		return ClimbHull(hull, points, localDir, startVertex);
+
+	// Check the top of the hierarchy point by point, then climb down through the levels below it
+	int supportVertex = topVertices[0];
+	float maxDistance = localDir.Dot(points[supportVertex]);
+	for (int topIndex = 1; topIndex < static_cast<int>(topVertices.size()); ++topIndex) {
+		const float distance = localDir.Dot(points[topVertices[topIndex]]);
+		if (distance > maxDistance) {
+			maxDistance = distance;
+			supportVertex = topVertices[topIndex];
+		}
+	}
+	for (int level = static_cast<int>(levels.size()) - 2; level >= 0; --level)
+		supportVertex = ClimbHull(levels[level], points, localDir, supportVertex);
+	return supportVertex;
+}
+
+/*
+====================================================
+ShapeConvex::GetSupportVertex
+====================================================
+*/
+int ShapeConvex::GetSupportVertex(const Vec3& localDir, const int startVertex) const {
+	return FindSupportVertex(m_supportLevels, m_topVertices, m_points, localDir, startVertex);
+}
+
+/*
+====================================================
+ShapeConvex::GetCoreSupportVertex
+====================================================
+*/
+int ShapeConvex::GetCoreSupportVertex(const Vec3& localDir, const int startVertex) const {
+	return FindSupportVertex(m_coreSupportLevels, m_coreTopVertices, m_corePoints, localDir, startVertex);
+}
+
+/*
+====================================================
+ShapeConvex::GetCoreSupportPointFrom
+====================================================
+*/
+Vec3 ShapeConvex::GetCoreSupportPointFrom(const Vec3& dir, const Vec3& pos, const Quat& orient, int& supportVertex) const {
+	const Vec3 localDir = orient.Inverse().RotatePoint(dir);
+	supportVertex = GetCoreSupportVertex(localDir, supportVertex);
+	return orient.RotatePoint(m_corePoints[supportVertex]) + pos;
+}
+
 /*
 ====================================================
 ShapeConvex::GetBounds
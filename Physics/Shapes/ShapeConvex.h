@@ -29,9 +29,39 @@ struct edge_t {
 	}
 };
 
+// coplanar hull triangles merged into one polygon
+struct hullFace_t {
+	Vec3 normal;
+	float distance;		// normal.Dot( p ) == distance for every point on the face
+	int firstVertex;	// into m_faceVertices, counter clockwise around the normal
+	int numVertices;
+};
+
+// an edge between two different faces, a to b runs counter clockwise around faceA
+struct hullEdge_t {
+	int a;
+	int b;
+	int faceA;
+	int faceB;
+};
+
+// the neighbors of every hull point, the ones of point i are neighbors[ offsets[ i ] ] up to neighbors[ offsets[ i + 1 ] ]
+struct hullAdjacency_t {
+	std::vector< int > offsets;
+	std::vector< int > neighbors;
+};
+
 
 
 void BuildConvexHull( const std::vector< Vec3 > & verts, std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris );
+void BuildHullFaces( const std::vector< Vec3 > & hullPts, const std::vector< tri_t > & hullTris,
+					 std::vector< hullFace_t > & faces, std::vector< int > & faceVerts, std::vector< hullEdge_t > & edges );
+void BuildHullAdjacency( const int numPoints, const std::vector< tri_t > & hullTris, hullAdjacency_t & adjacency );
+void BuildSupportHierarchy( const std::vector< Vec3 > & hullPts, const std::vector< tri_t > & hullTris,
+							std::vector< hullAdjacency_t > & levels, std::vector< int > & topVertices );
+float BuildHullCore( const std::vector< Vec3 > & hullPts, const std::vector< tri_t > & hullTris, const std::vector< hullFace_t > & faces,
+					 const float margin, std::vector< Vec3 > & corePts );
+void BuildCoreSupportHierarchy( const std::vector< Vec3 > & corePts, std::vector< hullAdjacency_t > & levels, std::vector< int > & topVertices );
 
 /*
 ====================================================
@@ -46,20 +76,52 @@ public:
 	void Build(const Vec3* pts, const int num) override;
 
 	Vec3 GetSupportPoint(const Vec3& dir, const Vec3& pos, const Quat& orient, const float bias) const override;
+	Vec3 GetSupportPointFrom(const Vec3& dir, const Vec3& pos, const Quat& orient, const float bias, int& supportVertex) const override;
+
+	float GetMargin() const override { return m_margin; }
+	Vec3 GetCoreSupportPointFrom(const Vec3& dir, const Vec3& pos, const Quat& orient, int& supportVertex) const override;
+
+	// index of the point furthest along a body space direction,
+	// climbs the hull from startVertex when it is one of the points, down the support hierarchy otherwise
+	int GetSupportVertex(const Vec3& localDir, const int startVertex = -1) const;
+	int GetCoreSupportVertex(const Vec3& localDir, const int startVertex = -1) const;
 
 	Mat3 GetInertiaTensor() const override { return m_inertiaTensor; }
 
 	Bounds GetBounds(const Vec3& pos, const Quat& orient) const override;
 	Bounds GetBounds() const override { return m_bounds; }
 
+	float GetBoundingRadius() const override { return m_boundingRadius; }
+
 	float GetFastestLinearSpeed(const Vec3& angularVelocity, const Vec3& dir) const override;
 
 	shapeType_t GetType() const override { return SHAPE_CONVEX; }
 
 public:
 	std::vector< Vec3 > m_points;
-	// todo
+	std::vector< float > m_pointCoordinates[ 3 ];	// m_points again, one array per axis padded to a multiple of four, for the batched queries
 	std::vector< tri_t >m_triangles;
+
+	// the polygonal faces and the edges between them, for the separating axis test
+	std::vector< hullFace_t > m_faces;
+	std::vector< int > m_faceVertices;
+	std::vector< hullEdge_t > m_edges;
+
+	// Dobkin-Kirkpatrick hierarchy for the support mapping, level 0 is the hull itself and every level above
+	// is the hull of what is left after dropping points that are not neighbors of each other, down to a handful of m_topVertices.
+	// All indices are into m_points.
+	std::vector< hullAdjacency_t > m_supportLevels;
+	std::vector< int > m_topVertices;
+
+	// every point moved in so the planes of its faces move in by m_margin, same indices as m_points
+	std::vector< Vec3 > m_corePoints;
+	float m_margin;
+
+	// the support hierarchy of the hull of m_corePoints, indexed like m_corePoints
+	std::vector< hullAdjacency_t > m_coreSupportLevels;
+	std::vector< int > m_coreTopVertices;
+
 	Bounds m_bounds;
+	float m_boundingRadius;	// farthest point from the center of mass
 	Mat3 m_inertiaTensor;
 };
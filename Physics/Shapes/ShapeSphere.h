@@ -22,6 +22,8 @@ public:
 	Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const override;
 	Bounds GetBounds() const override;
 
+	float GetBoundingRadius() const override { return m_radius; }
+
 	shapeType_t GetType() const override { return SHAPE_SPHERE; }
 
 public:
@@ -0,0 +1,145 @@
+//
+//  SweptBounds.cpp
+//
+#include "PCH.h"
+#include "SweptBounds.h"
+
+// padding on every side, prevents issues with bodies resting exactly on a boundary
+const float SweptBoundsBuffer::EPSILON = 0.01f;
+
+/*
+====================================================
+SweptBoundsBuffer::Clear
+====================================================
+*/
+void SweptBoundsBuffer::Clear() {
+	m_numBodies = 0;
+	m_globalBounds.Clear();
+	m_bodyIds.clear();
+	for (int axis = 0; axis < 3; ++axis) {
+		m_mins[axis].clear();
+		m_maxs[axis].clear();
+	}
+	m_packedBounds.clear();
+}
+
+/*
+====================================================
+SweptBoundsBuffer::ComputeBounds
+====================================================
+*/
+Bounds SweptBoundsBuffer::ComputeBounds(const Body& body, const float deltaSecond) {
+	Bounds bounds = body.m_shape->GetBounds(body.m_position, body.m_orientation);
+
+	// Expand bounds for continuous collision detection (CCD)
+	const Vec3 displacement = body.m_linearVelocity * deltaSecond;
+	bounds.Expand(bounds.mins + displacement);
+	bounds.Expand(bounds.maxs + displacement);
+
+	bounds.mins -= Vec3(EPSILON);
+	bounds.maxs += Vec3(EPSILON);
+	return bounds;
+}
+
+/*
+====================================================
+SweptBoundsBuffer::Resize
+====================================================
+*/
+void SweptBoundsBuffer::Resize(const int numBodies) {
+	m_numBodies = numBodies;
+	m_globalBounds.Clear();
+	m_bodyIds.resize(numBodies);
+	for (int axis = 0; axis < 3; ++axis) {
+		m_mins[axis].resize(numBodies);
+		m_maxs[axis].resize(numBodies);
+	}
+	m_packedBounds.resize(numBodies * 8);
+}
+
+/*
+====================================================
+SweptBoundsBuffer::SetBounds
+====================================================
+*/
+void SweptBoundsBuffer::SetBounds(const int localId, const Bounds& bounds) {
+	float* packedBox = &m_packedBounds[localId * 8];
+	for (int axis = 0; axis < 3; ++axis) {
+		m_mins[axis][localId] = bounds.mins[axis];
+		m_maxs[axis][localId] = bounds.maxs[axis];
+		packedBox[axis] = bounds.mins[axis];
+		packedBox[axis + 4] = bounds.maxs[axis];
+	}
+	packedBox[3] = 0.0f;
+	packedBox[7] = 0.0f;
+	m_globalBounds.Expand(bounds);
+}
+
+/*
+====================================================
+SweptBoundsBuffer::Update
+====================================================
+*/
+void SweptBoundsBuffer::Update(const Body* bodies, const int numBodies, const float deltaSecond) {
+	Resize(numBodies);
+	for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
+		m_bodyIds[currentBodyIndex] = currentBodyIndex;
+		SetBounds(currentBodyIndex, ComputeBounds(bodies[currentBodyIndex], deltaSecond));
+	}
+}
+
+/*
+====================================================
+SweptBoundsBuffer::Update
+
+Only the listed bodies, local index i holds bodies[bodyIds[i]].
+====================================================
+*/
+void SweptBoundsBuffer::Update(const Body* bodies, const std::vector<int>& bodyIds, const float deltaSecond) {
+	const int numBodies = static_cast<int>(bodyIds.size());
+	Resize(numBodies);
+	for (int localId = 0; localId < numBodies; ++localId) {
+		m_bodyIds[localId] = bodyIds[localId];
+		SetBounds(localId, ComputeBounds(bodies[bodyIds[localId]], deltaSecond));
+	}
+}
+
+/*
+====================================================
+SweptBoundsBuffer::GetBounds
+====================================================
+*/
+Bounds SweptBoundsBuffer::GetBounds(const int bodyId) const {
+	Bounds bounds;
+	bounds.mins = Vec3(m_mins[0][bodyId], m_mins[1][bodyId], m_mins[2][bodyId]);
+	bounds.maxs = Vec3(m_maxs[0][bodyId], m_maxs[1][bodyId], m_maxs[2][bodyId]);
+	return bounds;
+}
+
+/*
+====================================================
+SweptBoundsBuffer::GetSoA
+
+View of the entries from firstLocalId on, for IntersectBoundsBatch
+====================================================
+*/
+boundsSoA_t SweptBoundsBuffer::GetSoA(const int firstLocalId) const {
+	boundsSoA_t soa;
+	for (int axis = 0; axis < 3; ++axis) {
+		soa.mins[axis] = m_mins[axis].data() + firstLocalId;
+		soa.maxs[axis] = m_maxs[axis].data() + firstLocalId;
+	}
+	return soa;
+}
+
+/*
+====================================================
+SweptBoundsBuffer::GetMaxExtent
+====================================================
+*/
+float SweptBoundsBuffer::GetMaxExtent(const int bodyId) const {
+	const float extentX = m_maxs[0][bodyId] - m_mins[0][bodyId];
+	const float extentY = m_maxs[1][bodyId] - m_mins[1][bodyId];
+	const float extentZ = m_maxs[2][bodyId] - m_mins[2][bodyId];
+	return std::max(extentX, std::max(extentY, extentZ));
+}
@@ -0,0 +1,67 @@
+//
+//	SweptBounds.h
+//
+#pragma once
+#include "Body.h"
+#include <xmmintrin.h>
+
+/*
+====================================================
+SweptBoundsBuffer
+
+World bounds of every body for one step, expanded by the linear velocity for CCD.
+Each body's shape bounds are computed exactly once per step and stored as structure of arrays
+(one array per axis for the mins and the maxs), so the broadphases, the mid-phase
+and the debug tools can all read the same data without calling Shape::GetBounds again.
+A packed copy (mins and maxs as two 4-wide rows per body) backs the SIMD pair test.
+The buffer can cover a subset of the bodies, then the entries are indexed locally
+and GetBodyId maps them back to the index in the body array.
+====================================================
+*/
+class SweptBoundsBuffer {
+public:
+	SweptBoundsBuffer() : m_numBodies( 0 ) {}
+
+	void Update( const Body * bodies, const int numBodies, const float deltaSecond );
+	void Update( const Body * bodies, const std::vector< int > & bodyIds, const float deltaSecond );
+	void Clear();
+
+	static Bounds ComputeBounds( const Body & body, const float deltaSecond );
+
+	int GetNumBodies() const { return m_numBodies; }
+	int GetBodyId( const int localId ) const { return m_bodyIds[ localId ]; }
+	const Bounds & GetGlobalBounds() const { return m_globalBounds; }
+
+	const float * GetMins( const int axis ) const { return m_mins[ axis ].data(); }
+	const float * GetMaxs( const int axis ) const { return m_maxs[ axis ].data(); }
+	boundsSoA_t GetSoA( const int firstLocalId = 0 ) const;
+
+	Bounds GetBounds( const int bodyId ) const;
+	float GetMaxExtent( const int bodyId ) const;
+
+	// the 8 floats of the SIMD copy, minX, minY, minZ, 0, maxX, maxY, maxZ, 0
+	const float * GetPackedBounds( const int bodyId ) const { return &m_packedBounds[ bodyId * 8 ]; }
+
+	// full 3D overlap test of two bodies, all three axes in one SSE compare
+	bool DoesIntersect( const int bodyA, const int bodyB ) const {
+		const float * boxA = &m_packedBounds[ bodyA * 8 ];
+		const float * boxB = &m_packedBounds[ bodyB * 8 ];
+		const __m128 separatedLow = _mm_cmplt_ps( _mm_loadu_ps( boxA + 4 ), _mm_loadu_ps( boxB ) );
+		const __m128 separatedHigh = _mm_cmplt_ps( _mm_loadu_ps( boxB + 4 ), _mm_loadu_ps( boxA ) );
+		return 0 == ( _mm_movemask_ps( _mm_or_ps( separatedLow, separatedHigh ) ) & 0x7 );
+	}
+
+	static const float EPSILON;
+
+private:
+	void Resize( const int numBodies );
+	void SetBounds( const int localId, const Bounds & bounds );
+
+	int m_numBodies;
+	std::vector< int > m_bodyIds;
+	Bounds m_globalBounds;
+
+	std::vector< float > m_mins[ 3 ];
+	std::vector< float > m_maxs[ 3 ];
+	std::vector< float > m_packedBounds;	// minX, minY, minZ, 0, maxX, maxY, maxZ, 0 per body
+};
@@ -0,0 +1,170 @@
+//
+//  ThreadPool.cpp
+//
+#include "PCH.h"
+#include "ThreadPool.h"
+
+/*
+====================================================
+ThreadPool::ThreadPool
+====================================================
+*/
+ThreadPool::ThreadPool(const int numThreads) :
+	m_numThreads(numThreads),
+	m_task(nullptr),
+	m_generation(0),
+	m_numActiveWorkers(0),
+	m_isShuttingDown(false) {
+	if (m_numThreads <= 0)
+		m_numThreads = static_cast<int>(std::thread::hardware_concurrency());
+	m_numThreads = std::max(1, std::min(m_numThreads, MAX_THREADS));
+
+	m_queues.reserve(m_numThreads);
+	for (int threadIndex = 0; threadIndex < m_numThreads; ++threadIndex)
+		m_queues.emplace_back(new workQueue_t());
+
+	m_workers.reserve(m_numThreads - 1);
+	for (int threadIndex = 1; threadIndex < m_numThreads; ++threadIndex)
+		m_workers.emplace_back(&ThreadPool::WorkerMain, this, threadIndex);
+}
+
+/*
+====================================================
+ThreadPool::~ThreadPool
+====================================================
+*/
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isShuttingDown = true;
+	}
+	m_wakeCondition.notify_all();
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+/*
+====================================================
+ThreadPool::ParallelFor
+====================================================
+*/
+void ThreadPool::ParallelFor(const int count, const int grainSize, const task_t& task) {
+	if (count <= 0)
+		return;
+
+	const int chunkSize = std::max(1, grainSize);
+	const int numChunks = (count + chunkSize - 1) / chunkSize;
+
+	// Not worth waking anybody up
+	if (1 == m_numThreads || 1 == numChunks) {
+		for (int begin = 0; begin < count; begin += chunkSize)
+			task(begin, std::min(count, begin + chunkSize), 0);
+		return;
+	}
+
+	// Deal the chunks round robin, the workers are all asleep at this point so nobody is popping yet
+	for (int chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex) {
+		range_t range;
+		range.begin = chunkIndex * chunkSize;
+		range.end = std::min(count, range.begin + chunkSize);
+
+		workQueue_t& queue = *m_queues[chunkIndex % m_numThreads];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.ranges.push_back(range);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		++m_generation;
+	}
+	m_wakeCondition.notify_all();
+
+	RunChunks(0, task);
+
+	// Our queues are empty, but workers may still be running the chunks they took
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return 0 == m_numActiveWorkers; });
+	m_task = nullptr;
+}
+
+/*
+====================================================
+ThreadPool::WorkerMain
+====================================================
+*/
+void ThreadPool::WorkerMain(const int threadIndex) {
+	uint32_t lastGeneration = 0;
+	while (true) {
+		const task_t* task = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			// a worker that wakes up after the loop has finished sees no task and goes back to sleep
+			m_wakeCondition.wait(lock, [this, lastGeneration]() {
+				return m_isShuttingDown || (nullptr != m_task && m_generation != lastGeneration);
+			});
+			if (m_isShuttingDown)
+				return;
+
+			lastGeneration = m_generation;
+			task = m_task;
+			++m_numActiveWorkers;
+		}
+
+		RunChunks(threadIndex, *task);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_numActiveWorkers;
+		}
+		m_doneCondition.notify_one();
+	}
+}
+
+/*
+====================================================
+ThreadPool::RunChunks
+====================================================
+*/
+void ThreadPool::RunChunks(const int threadIndex, const task_t& task) {
+	range_t range;
+	while (PopRange(threadIndex, range) || StealRange(threadIndex, range))
+		task(range.begin, range.end, threadIndex);
+}
+
+/*
+====================================================
+ThreadPool::PopRange
+====================================================
+*/
+bool ThreadPool::PopRange(const int threadIndex, range_t& range) {
+	workQueue_t& queue = *m_queues[threadIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.ranges.empty())
+		return false;
+
+	range = queue.ranges.back();
+	queue.ranges.pop_back();
+	return true;
+}
+
+/*
+====================================================
+ThreadPool::StealRange
+
+Takes the oldest chunk of the next thread that still has work.
+====================================================
+*/
+bool ThreadPool::StealRange(const int threadIndex, range_t& range) {
+	for (int offset = 1; offset < m_numThreads; ++offset) {
+		workQueue_t& queue = *m_queues[(threadIndex + offset) % m_numThreads];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.ranges.empty())
+			continue;
+
+		range = queue.ranges.front();
+		queue.ranges.pop_front();
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,61 @@
+//
+//	ThreadPool.h
+//
+#pragma once
+
+/*
+====================================================
+ThreadPool
+
+Persistent worker threads for data parallel loops.
+ParallelFor splits the range into chunks that are dealt round robin to one queue per thread.
+Each thread pops chunks from the back of its own queue and, once it is empty,
+steals chunks from the front of the other queues, so uneven chunks balance themselves.
+The calling thread takes part as thread 0 and the call returns when every chunk is done.
+====================================================
+*/
+class ThreadPool {
+public:
+	typedef std::function< void( int begin, int end, int threadIndex ) > task_t;
+
+	explicit ThreadPool( const int numThreads = 0 );	// 0 uses one thread per hardware thread
+	~ThreadPool();
+
+	int GetNumThreads() const { return m_numThreads; }
+
+	// Calls task( begin, end, threadIndex ) on [ 0, count ) in chunks of at most grainSize
+	void ParallelFor( const int count, const int grainSize, const task_t & task );
+
+	static const int MAX_THREADS = 16;
+
+private:
+	struct range_t {
+		int begin;
+		int end;
+	};
+
+	struct workQueue_t {
+		std::mutex mutex;
+		std::deque< range_t > ranges;
+	};
+
+	ThreadPool( const ThreadPool & ) = delete;
+	ThreadPool & operator=( const ThreadPool & ) = delete;
+
+	void WorkerMain( const int threadIndex );
+	void RunChunks( const int threadIndex, const task_t & task );
+	bool PopRange( const int threadIndex, range_t & range );
+	bool StealRange( const int threadIndex, range_t & range );
+
+	int m_numThreads;
+	std::vector< std::thread > m_workers;
+	std::vector< std::unique_ptr< workQueue_t > > m_queues;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	const task_t * m_task;		// only set while a ParallelFor is running
+	uint32_t m_generation;		// bumped by every ParallelFor so sleeping workers notice new work
+	int m_numActiveWorkers;
+	bool m_isShuttingDown;
+};